@@ -0,0 +1,170 @@
+#pragma once
+
+// what the benchmarks against the in-process mock server share: their common options, the log, the mock server,
+// the synthetic accounts and writing the results
+namespace MockBench
+{
+	class CArgs
+	{
+	public:
+		size_t		accounts = 100;
+		size_t		listings = 10;
+		double		salesPerMin = 1;		// per account and market
+		double		purchasesPerMin = 0;	// per account and market
+		const char*	script = nullptr;
+		const char*	out = nullptr;
+		const char*	log = "/dev/null";
+		const char*	label = "";
+	};
+
+	// the defaults are the benchmark's own
+	void PrintHelp(const CArgs& defaults)
+	{
+		fprintf(stderr,
+			"--accounts [count]\t\tSynthetic accounts, %zu by default\n"
+			"--listings [count]\t\tItems listed per account and market, %zu by default\n"
+			"--sales-per-min [rate]\t\tAverage sales per account and market per minute, %g by default\n"
+			"--purchases-per-min [rate]\tAverage purchases per account and market per minute, %g by default\n"
+			"--script [path]\t\t\tMock server latency, error and 429 rules\n"
+			"--out [path]\t\t\tResults, %s by default\n"
+			"--log [path]\t\t\tClient log, %s by default\n"
+			"--label [text]\t\t\tStored with the results, e.g. the client version or the policy being evaluated\n",
+			defaults.accounts, defaults.listings, defaults.salesPerMin, defaults.purchasesPerMin, defaults.out, defaults.log);
+	}
+
+	// takes the option at argv[*i] and its value if it's a common one
+	bool ParseArg(int argc, char** argv, int* i, CArgs* out)
+	{
+		const char* arg = argv[*i];
+
+		if (argc - 1 <= *i)
+			return false;
+
+		if (!strcmp(arg, "--accounts"))
+			out->accounts = strtoull(argv[++*i], nullptr, 10);
+		else if (!strcmp(arg, "--listings"))
+			out->listings = strtoull(argv[++*i], nullptr, 10);
+		else if (!strcmp(arg, "--sales-per-min"))
+			out->salesPerMin = atof(argv[++*i]);
+		else if (!strcmp(arg, "--purchases-per-min"))
+			out->purchasesPerMin = atof(argv[++*i]);
+		else if (!strcmp(arg, "--script"))
+			out->script = argv[++*i];
+		else if (!strcmp(arg, "--out"))
+			out->out = argv[++*i];
+		else if (!strcmp(arg, "--log"))
+			out->log = argv[++*i];
+		else if (!strcmp(arg, "--label"))
+			out->label = argv[++*i];
+		else
+			return false;
+
+		return true;
+	}
+
+	// the client logs every step of every account, start a Logger::CWriterContext after this
+	bool OpenLog(const char* path)
+	{
+		if (!freopen(path, "w", stdout))
+		{
+			fprintf(stderr, "Opening log %s failed\n", path);
+			return false;
+		}
+
+		setvbuf(stdout, nullptr, _IOFBF, BUFSIZ);
+
+		g_bNonInteractive = true;
+		SetExitSignalHandlers();
+
+		return true;
+	}
+
+	// the rest of Mock::config is the benchmark's to set before, points the client at the server
+	bool StartMock(const CArgs& args, CHttpServer* server, std::string* outBaseUrl)
+	{
+		Mock::config.listings = args.listings;
+		Mock::config.salesPerMin = args.salesPerMin;
+		Mock::config.purchasesPerMin = args.purchasesPerMin;
+
+		if (args.script && !Mock::LoadScript(args.script))
+			return false;
+
+		if (!server->Start("127.0.0.1", 0, Mock::HandleRequest))
+		{
+			fputs("Starting the mock server failed\n", stderr);
+			return false;
+		}
+
+		*outBaseUrl = "http://127.0.0.1:" + std::to_string(server->GetPort());
+
+		return Curl::SetBaseUrl(outBaseUrl->c_str());
+	}
+
+	// the client's handle with a Steam session, nullptr if it failed
+	CURL* InitClient(char* outSessionId)
+	{
+		CURL* curl = Curl::Init(nullptr);
+		if (!curl)
+			return nullptr;
+
+		if (!Steam::GenerateSessionId(outSessionId) || !Steam::SetSessionCookie(curl, outSessionId))
+		{
+			curl_easy_cleanup(curl);
+			return nullptr;
+		}
+
+		return curl;
+	}
+
+	// accounts named prefix0, prefix1... with market API keys of the prefix in capitals padded with the index
+	bool CreateAccounts(CURL* curl, const char* prefix, std::vector<CAccount>* outAccounts)
+	{
+		// random test secret, not a real account's
+		const char identitySecret[] = "c2VjcmV0IGlkZW50aXR5IGtleSE=";
+
+		char keyPrefix[16];
+		size_t keyPrefixLen = 0;
+
+		for (; prefix[keyPrefixLen] && keyPrefixLen < sizeof(keyPrefix) - 1; ++keyPrefixLen)
+			keyPrefix[keyPrefixLen] = (char)toupper((unsigned char)prefix[keyPrefixLen]);
+
+		keyPrefix[keyPrefixLen] = '\0';
+
+		for (size_t i = 0; i < outAccounts->size(); ++i)
+		{
+			char name[32], marketApiKey[Market::apiKeySz + 1], steamId64[UINT64_MAX_STR_SIZE], steamApiKey[Steam::apiKeyBufSz];
+
+			snprintf(name, sizeof(name), "%s%zu", prefix, i);
+			snprintf(marketApiKey, sizeof(marketApiKey), "%s%0*zu", keyPrefix, (int)(Market::apiKeySz - keyPrefixLen), i);
+			snprintf(steamId64, sizeof(steamId64), "%llu", (unsigned long long)Steam::SteamID32To64(1000000 + (uint32_t)i));
+			snprintf(steamApiKey, sizeof(steamApiKey), "%032zX", i);
+
+			if (!(*outAccounts)[i].InitSynthetic(name, marketApiKey, steamId64, identitySecret, steamApiKey))
+			{
+				fprintf(stderr, "Creating account %zu failed\n", i);
+				return false;
+			}
+
+			Mock::steamApiKeyOwners[steamApiKey] = steamId64;
+		}
+
+		// the client keeps one refresh cookie, the mock issues a login for whoever it names
+		return Steam::SetRefreshCookie(curl, "76561197960265728", prefix);
+	}
+
+	bool WriteResults(const char* path, const rapidjson::StringBuffer& buffer)
+	{
+		FILE* file = fopen(path, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "Opening %s failed\n", path);
+			return false;
+		}
+
+		fputs(buffer.GetString(), file);
+		fputc('\n', file);
+		fclose(file);
+
+		return true;
+	}
+}
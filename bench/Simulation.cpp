@@ -0,0 +1,311 @@
+// simulates hours of ticks of synthetic accounts against the in-process mock server in virtual time,
+// rate limits, poll intervals, offer TTLs and the mock's scripted latency pass instantly, so scheduler and rate limit
+// policies can be compared by how fast sold items get delivered and how many offers expire
+#include "Precompiled.h"
+#include <chrono>
+#include <random>
+#include "RingBuffer.h"
+#include "Log.h"
+#include "Misc.h"
+#include "Clock.h"
+#include "Curl.h"
+#include "Crypto.h"
+#include "Counter.h"
+#include "Events.h"
+#include "Histogram.h"
+#include "Latency.h"
+#include "Trace.h"
+#include "SharedRateLimit.h"
+#include "RateLimiter.h"
+#include "Backoff.h"
+#include "Resolver.h"
+#include "ProxyPool.h"
+#include "SourceAddress.h"
+#include "HttpServer.h"
+#include "Capture.h"
+#include "Request.h"
+#include "Steam/Steam.h"
+#include "Market.h"
+#include "Push.h"
+#include "Sla.h"
+#include "Metrics.h"
+#include "Account.h"
+#include "Mock.h"
+#include "MockBench.h"
+
+class CArgs
+{
+public:
+	MockBench::CArgs	mock;
+	double		acceptDelaySec = 60;
+	double		hours = 6;
+	int			pollMinSec = (int)CAccount::pollIntervalMin.count();
+	int			pollMaxSec = (int)CAccount::pollIntervalMax.count();
+	int			emptyMarketProbeMin = (int)(CAccount::emptyMarketProbeInterval.count() / 60);
+	int			marketIntervalMs = 1000;
+	int			steamIntervalMs = 1000;
+	uint32_t	seed = 1;
+	int64_t		startTime = 1767225600;	// unix time the simulation starts at
+
+	CArgs()
+	{
+		mock.salesPerMin = 0.1;
+		mock.out = "simulation.json";
+	}
+};
+
+bool ParseArgs(int argc, char** argv, CArgs* out)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+
+		if (!strcmp(arg, "--help"))
+		{
+			fputs("Options:\n", stderr);
+			MockBench::PrintHelp(CArgs().mock);
+			fputs("--accept-delay [seconds]\tAverage time buyers take to accept offers, 60 by default, 0 never accepts\n"
+				"--hours [hours]\t\t\tSimulated time, 6 by default\n"
+				"--poll-min [seconds]\t\tHow soon a market with activity is polled again, like the client's option\n"
+				"--poll-max [seconds]\t\tHow long polls of a quiet market back off to, like the client's option\n"
+				"--empty-market-probe [minutes]\tHow often markets without items are polled, like the client's option\n"
+				"--market-interval [ms]\t\tSpacing of Market requests, 1000 by default\n"
+				"--steam-interval [ms]\t\tSpacing of Steam requests, 1000 by default\n"
+				"--seed [seed]\t\t\tSeed of the sales, purchases and rules\n"
+				"--start-time [unix time]\tWhen the simulation starts, 2026-01-01 by default\n"
+				"The script's delays pass in virtual time\n", stderr);
+			return false;
+		}
+		else if (MockBench::ParseArg(argc, argv, &i, &out->mock))
+			continue;
+		else if ((i < (argc - 1)) && !strcmp(arg, "--accept-delay"))
+			out->acceptDelaySec = atof(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--hours"))
+			out->hours = atof(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--poll-min"))
+			out->pollMinSec = atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--poll-max"))
+			out->pollMaxSec = atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--empty-market-probe"))
+			out->emptyMarketProbeMin = atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--market-interval"))
+			out->marketIntervalMs = atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--steam-interval"))
+			out->steamIntervalMs = atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--seed"))
+			out->seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--start-time"))
+			out->startTime = strtoll(argv[++i], nullptr, 10);
+		else
+		{
+			fprintf(stderr, "Unknown argument: %s\n", arg);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	CArgs args;
+	if (!ParseArgs(argc, argv, &args))
+		return 1;
+
+	// before anything reads the clock
+	Clock::StartVirtual(args.startTime * 1000);
+
+	if (!MockBench::OpenLog(args.mock.log))
+		return 1;
+
+	Logger::CWriterContext logWriter;
+
+	Mock::config.acceptDelaySec = args.acceptDelaySec;
+	Mock::config.seed = args.seed;
+
+	CHttpServer mockServer;
+	std::string baseUrl;
+
+	if (!MockBench::StartMock(args.mock, &mockServer, &baseUrl))
+		return 1;
+
+	Market::requestInterval = std::chrono::milliseconds(args.marketIntervalMs);
+	Steam::requestInterval = std::chrono::milliseconds(args.steamIntervalMs);
+
+	// like the client, a zero interval would poll in a loop without ever moving virtual time
+	args.pollMinSec = std::max(args.pollMinSec, 1);
+	args.emptyMarketProbeMin = std::max(args.emptyMarketProbeMin, 1);
+
+	CAccount::pollIntervalMin = std::chrono::seconds(args.pollMinSec);
+	CAccount::pollIntervalMax = std::chrono::seconds(std::max(args.pollMinSec, args.pollMaxSec));
+	CAccount::emptyMarketProbeInterval = std::chrono::minutes(args.emptyMarketProbeMin);
+
+	char sessionId[Steam::sessionIdBufSz];
+
+	CURL* curl = MockBench::InitClient(sessionId);
+	if (!curl)
+		return 1;
+
+	std::vector<CAccount> accounts(args.mock.accounts);
+
+	if (!MockBench::CreateAccounts(curl, "sim", &accounts))
+		return 1;
+
+	fprintf(stderr, "Simulating %zu accounts for %.1f hours...\n", accounts.size(), args.hours);
+
+	const auto realStartTime = std::chrono::steady_clock::now();
+	const auto startTime = Clock::Now();
+	const auto endTime = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double, std::ratio<3600>>(args.hours));
+
+	uint64_t tickCount = 0;
+	uint64_t failedAccountTickCount = 0;
+
+	CHistogram tickDuration;	// virtual microseconds
+	CHistogram accountTickDuration;
+
+	while (Clock::Now() < endTime && !g_nExitSignal)
+	{
+		const auto tickStartTime = Clock::Now();
+
+		// only accounts with a due market or housekeeping, like the client
+		for (auto& account : accounts)
+		{
+			if (tickStartTime < account.GetNextRunTime())
+				continue;
+
+			const auto accountStartTime = Clock::Now();
+
+			if (!account.RunMarkets(curl, sessionId, nullptr))
+				++failedAccountTickCount;
+
+			accountTickDuration.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+				Clock::Now() - accountStartTime).count());
+		}
+
+		tickDuration.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+			Clock::Now() - tickStartTime).count());
+
+		++tickCount;
+
+		auto nextTickTime = endTime;
+		for (const auto& account : accounts)
+			nextTickTime = std::min(nextTickTime, account.GetNextRunTime());
+
+		Clock::SleepUntil(nextTickTime);
+	}
+
+	const double simulatedSec = std::chrono::duration<double>(Clock::Now() - startTime).count();
+	const double realSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - realStartTime).count();
+
+	uint64_t requestCount = 0;
+	uint64_t failedRequestCount = 0;
+	uint64_t rateLimitWaitUs = 0;
+
+	Latency::ForEachEndpoint([&](const Latency::CEndpoint* endpoint)
+	{
+		requestCount += endpoint->okCount.Get() + endpoint->httpErrorCount.Get() + endpoint->curlErrorCount.Get();
+		failedRequestCount += endpoint->httpErrorCount.Get() + endpoint->curlErrorCount.Get();
+		rateLimitWaitUs += endpoint->phases[(size_t)Latency::Phase::RATE_LIMIT].GetSum();
+	});
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+
+	writer.Key("label");
+	writer.String(args.mock.label);
+
+	writer.Key("config");
+	writer.StartObject();
+	writer.Key("accounts");
+	writer.Uint64(args.mock.accounts);
+	writer.Key("listings");
+	writer.Uint64(args.mock.listings);
+	writer.Key("sales_per_min");
+	writer.Double(args.mock.salesPerMin);
+	writer.Key("purchases_per_min");
+	writer.Double(args.mock.purchasesPerMin);
+	writer.Key("accept_delay_s");
+	writer.Double(args.acceptDelaySec);
+	writer.Key("poll_min_s");
+	writer.Int(args.pollMinSec);
+	writer.Key("poll_max_s");
+	writer.Int(args.pollMaxSec);
+	writer.Key("empty_market_probe_min");
+	writer.Int(args.emptyMarketProbeMin);
+	writer.Key("market_interval_ms");
+	writer.Int(args.marketIntervalMs);
+	writer.Key("steam_interval_ms");
+	writer.Int(args.steamIntervalMs);
+	writer.Key("seed");
+	writer.Uint(args.seed);
+	writer.EndObject();
+
+	writer.Key("simulated_s");
+	writer.Double(simulatedSec);
+	writer.Key("real_s");
+	writer.Double(realSec);
+	writer.Key("speedup");
+	writer.Double(realSec ? (simulatedSec / realSec) : 0);
+
+	writer.Key("ticks");
+	writer.Uint64(tickCount);
+	writer.Key("failed_account_ticks");
+	writer.Uint64(failedAccountTickCount);
+
+	// virtual time
+	writer.Key("tick_duration_us");
+	Mock::WriteHistogram(&writer, tickDuration);
+	writer.Key("account_tick_duration_us");
+	Mock::WriteHistogram(&writer, accountTickDuration);
+	writer.Key("sale_to_trade_ready_us");
+	Mock::WriteHistogram(&writer, Mock::stats.saleToTradeReady);
+	writer.Key("purchase_to_accepted_us");
+	Mock::WriteHistogram(&writer, Mock::stats.purchaseToAccepted);
+
+	writer.Key("requests");
+	writer.Uint64(requestCount);
+	writer.Key("failed_requests");
+	writer.Uint64(failedRequestCount);
+	writer.Key("throttled_requests");
+	writer.Uint64(Mock::stats.throttled);
+	writer.Key("rate_limit_wait_s");
+	writer.Double(rateLimitWaitUs / 1e6);
+
+	writer.Key("sales");
+	writer.Uint64(Mock::stats.sales);
+	writer.Key("purchases");
+	writer.Uint64(Mock::stats.purchases);
+	writer.Key("offers_sent");
+	writer.Uint64(Mock::stats.offersSent);
+	writer.Key("offers_accepted");
+	writer.Uint64(Mock::stats.offersAccepted);
+	writer.Key("offers_cancelled");
+	writer.Uint64(Mock::stats.offersCancelled);
+	writer.Key("items_given");
+	writer.Uint64(Mock::stats.itemsGiven);
+	writer.Key("items_taken");
+	writer.Uint64(Mock::stats.itemsTaken);
+	writer.Key("items_expired");
+	writer.Uint64(Mock::stats.itemsExpired);
+
+	writer.EndObject();
+
+	if (!MockBench::WriteResults(args.mock.out, buffer))
+		return 1;
+
+	fprintf(stderr, "%.1f simulated hours in %.1f s, %llu ticks (p50 %.0f s), sale to trade-ready p50 %.0f s p99 %.0f s, "
+		"%llu offers cancelled, %llu items expired, written to %s\n",
+		simulatedSec / 3600, realSec, (unsigned long long)tickCount, tickDuration.GetQuantile(0.50) / 1e6,
+		Mock::stats.saleToTradeReady.GetQuantile(0.50) / 1e6, Mock::stats.saleToTradeReady.GetQuantile(0.99) / 1e6,
+		(unsigned long long)Mock::stats.offersCancelled, (unsigned long long)Mock::stats.itemsExpired, args.mock.out);
+
+	curl_easy_cleanup(curl);
+	curl_global_cleanup();
+
+	mockServer.Stop();
+
+	return 0;
+}
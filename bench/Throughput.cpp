@@ -0,0 +1,287 @@
+// runs synthetic accounts against the in-process mock server tick after tick, as fast as the client can,
+// and writes ticks per second, sale to trade-ready latency, CPU, RSS and requests per delivered item as JSON
+#include "Precompiled.h"
+#include <chrono>
+#include <random>
+#include <sys/resource.h>
+#include "RingBuffer.h"
+#include "Log.h"
+#include "Misc.h"
+#include "Clock.h"
+#include "Curl.h"
+#include "Crypto.h"
+#include "Counter.h"
+#include "Events.h"
+#include "Histogram.h"
+#include "Latency.h"
+#include "Trace.h"
+#include "SharedRateLimit.h"
+#include "RateLimiter.h"
+#include "Backoff.h"
+#include "Resolver.h"
+#include "ProxyPool.h"
+#include "SourceAddress.h"
+#include "HttpServer.h"
+#include "Capture.h"
+#include "Request.h"
+#include "Steam/Steam.h"
+#include "Market.h"
+#include "Push.h"
+#include "Sla.h"
+#include "Metrics.h"
+#include "Account.h"
+#include "Mock.h"
+#include "MockBench.h"
+
+class CArgs
+{
+public:
+	MockBench::CArgs	mock;
+	int			durationSec = 60;
+	int			requestIntervalMs = 0;	// client rate limit, 0 disables it
+
+	CArgs()
+	{
+		mock.out = "throughput.json";
+	}
+};
+
+// CPU time of the calling thread, which is where the client runs, the mock runs on its own threads
+double GetThreadCpuSec()
+{
+	rusage usage;
+	if (getrusage(RUSAGE_THREAD, &usage))
+		return 0;
+
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// current and peak resident set size of the process in KB, 0 if unknown
+void GetRssKb(uint64_t* outRss, uint64_t* outPeakRss)
+{
+	*outRss = 0;
+	*outPeakRss = 0;
+
+	FILE* file = fopen("/proc/self/status", "rb");
+	if (!file)
+		return;
+
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		if (!strncmp(line, "VmRSS:", 6))
+			*outRss = strtoull(line + 6, nullptr, 10);
+		else if (!strncmp(line, "VmHWM:", 6))
+			*outPeakRss = strtoull(line + 6, nullptr, 10);
+	}
+
+	fclose(file);
+}
+
+bool ParseArgs(int argc, char** argv, CArgs* out)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+
+		if (!strcmp(arg, "--help"))
+		{
+			fputs("Options:\n", stderr);
+			MockBench::PrintHelp(CArgs().mock);
+			fputs("--duration [seconds]\t\tHow long to run, 60 by default\n"
+				"--request-interval [ms]\t\tClient rate limit per Market and Steam request, 0 by default\n", stderr);
+			return false;
+		}
+		else if (MockBench::ParseArg(argc, argv, &i, &out->mock))
+			continue;
+		else if ((i < (argc - 1)) && !strcmp(arg, "--duration"))
+			out->durationSec = atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--request-interval"))
+			out->requestIntervalMs = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Unknown argument: %s\n", arg);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	CArgs args;
+	if (!ParseArgs(argc, argv, &args))
+		return 1;
+
+	if (!MockBench::OpenLog(args.mock.log))
+		return 1;
+
+	Logger::CWriterContext logWriter;
+
+	CHttpServer mockServer;
+	std::string baseUrl;
+
+	if (!MockBench::StartMock(args.mock, &mockServer, &baseUrl))
+		return 1;
+
+	Market::requestInterval = std::chrono::milliseconds(args.requestIntervalMs);
+	Steam::requestInterval = std::chrono::milliseconds(args.requestIntervalMs);
+
+	// every account polls every market on every call, whatever the scheduling
+	CAccount::pollIntervalMin = 0s;
+	CAccount::pollIntervalMax = 0s;
+	CAccount::emptyMarketProbeInterval = 0s;
+	CAccount::housekeepingInterval = 0s;
+
+	char sessionId[Steam::sessionIdBufSz];
+
+	CURL* curl = MockBench::InitClient(sessionId);
+	if (!curl)
+		return 1;
+
+	uint64_t rssBeforeKb, peakRssKb;
+	GetRssKb(&rssBeforeKb, &peakRssKb);
+
+	std::vector<CAccount> accounts(args.mock.accounts);
+
+	if (!MockBench::CreateAccounts(curl, "bench", &accounts))
+		return 1;
+
+	fprintf(stderr, "Running %zu accounts against %s for %d s...\n", accounts.size(), baseUrl.c_str(), args.durationSec);
+
+	const auto startTime = std::chrono::steady_clock::now();
+	const auto endTime = startTime + std::chrono::seconds(args.durationSec);
+	const double startCpuSec = GetThreadCpuSec();
+
+	uint64_t tickCount = 0;
+	uint64_t accountTickCount = 0;
+	uint64_t failedAccountTickCount = 0;
+
+	CHistogram tickDuration;	// microseconds
+
+	while (std::chrono::steady_clock::now() < endTime && !g_nExitSignal)
+	{
+		const auto tickStartTime = std::chrono::steady_clock::now();
+
+		for (auto& account : accounts)
+		{
+			if (!account.RunMarkets(curl, sessionId, nullptr))
+				++failedAccountTickCount;
+
+			++accountTickCount;
+		}
+
+		tickDuration.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - tickStartTime).count());
+
+		++tickCount;
+	}
+
+	const double elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	const double cpuSec = GetThreadCpuSec() - startCpuSec;
+
+	uint64_t rssKb;
+	GetRssKb(&rssKb, &peakRssKb);
+
+	uint64_t requestCount = 0;
+	Latency::ForEachEndpoint([&requestCount](const Latency::CEndpoint* endpoint)
+	{
+		requestCount += endpoint->okCount.Get() + endpoint->httpErrorCount.Get() + endpoint->curlErrorCount.Get();
+	});
+
+	const uint64_t deliveredCount = Mock::stats.itemsGiven + Mock::stats.itemsTaken;
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+
+	writer.Key("label");
+	writer.String(args.mock.label);
+	writer.Key("timestamp");
+	writer.Int64(time(nullptr));
+
+	writer.Key("config");
+	writer.StartObject();
+	writer.Key("accounts");
+	writer.Uint64(args.mock.accounts);
+	writer.Key("listings");
+	writer.Uint64(args.mock.listings);
+	writer.Key("sales_per_min");
+	writer.Double(args.mock.salesPerMin);
+	writer.Key("purchases_per_min");
+	writer.Double(args.mock.purchasesPerMin);
+	writer.Key("duration_s");
+	writer.Int(args.durationSec);
+	writer.Key("request_interval_ms");
+	writer.Int(args.requestIntervalMs);
+	writer.EndObject();
+
+	writer.Key("elapsed_s");
+	writer.Double(elapsedSec);
+	writer.Key("ticks");
+	writer.Uint64(tickCount);
+	writer.Key("ticks_per_s");
+	writer.Double(tickCount / elapsedSec);
+	writer.Key("account_ticks_per_s");
+	writer.Double(accountTickCount / elapsedSec);
+	writer.Key("failed_account_ticks");
+	writer.Uint64(failedAccountTickCount);
+
+	writer.Key("tick_duration_us");
+	Mock::WriteHistogram(&writer, tickDuration);
+	writer.Key("sale_to_trade_ready_us");
+	Mock::WriteHistogram(&writer, Mock::stats.saleToTradeReady);
+	writer.Key("purchase_to_accepted_us");
+	Mock::WriteHistogram(&writer, Mock::stats.purchaseToAccepted);
+
+	writer.Key("cpu_s");
+	writer.Double(cpuSec);
+	writer.Key("cpu_ms_per_account_tick");
+	writer.Double(accountTickCount ? (cpuSec * 1e3 / accountTickCount) : 0);
+	writer.Key("cpu_share_per_account");
+	writer.Double(cpuSec / elapsedSec / std::max<size_t>(args.mock.accounts, 1));
+
+	// includes the mock server
+	writer.Key("rss_kb");
+	writer.Uint64(rssKb);
+	writer.Key("peak_rss_kb");
+	writer.Uint64(peakRssKb);
+	writer.Key("rss_kb_per_account");
+	writer.Double((rssKb - std::min(rssKb, rssBeforeKb)) / (double)std::max<size_t>(args.mock.accounts, 1));
+
+	writer.Key("requests");
+	writer.Uint64(requestCount);
+	writer.Key("sales");
+	writer.Uint64(Mock::stats.sales);
+	writer.Key("purchases");
+	writer.Uint64(Mock::stats.purchases);
+	writer.Key("items_delivered");
+	writer.Uint64(deliveredCount);
+	writer.Key("items_expired");
+	writer.Uint64(Mock::stats.itemsExpired);
+	writer.Key("requests_per_delivered_item");
+	writer.Double(deliveredCount ? ((double)requestCount / deliveredCount) : 0);
+
+	writer.EndObject();
+
+	if (!MockBench::WriteResults(args.mock.out, buffer))
+		return 1;
+
+	fprintf(stderr, "%llu ticks (%.2f/s), %.2f ms CPU per account tick, sale to trade-ready p50 %.1f ms p99 %.1f ms, "
+		"%.1f requests per delivered item, written to %s\n",
+		(unsigned long long)tickCount, tickCount / elapsedSec,
+		accountTickCount ? (cpuSec * 1e3 / accountTickCount) : 0,
+		Mock::stats.saleToTradeReady.GetQuantile(0.50) / 1e3,
+		Mock::stats.saleToTradeReady.GetQuantile(0.99) / 1e3,
+		deliveredCount ? ((double)requestCount / deliveredCount) : 0,
+		args.mock.out);
+
+	curl_easy_cleanup(curl);
+	curl_global_cleanup();
+
+	mockServer.Stop();
+
+	return 0;
+}
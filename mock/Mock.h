@@ -0,0 +1,1561 @@
+#pragma once
+
+// stand-in for the Market and Steam endpoints the client uses, for testing and load tests without the real services
+// the client is pointed at it with --base-url, so requests arrive as /<host>/<path>, e.g. /steamcommunity.com/mobileconf/getlist
+// accounts are created on first sight of their market API key, Steam requests are tied to them through the asset ids
+// of their offers and the steamLoginSecure cookie, nothing is authenticated
+namespace Mock
+{
+	const char* marketHosts[] =
+	{
+		"market.csgo.com",
+		"market.dota2.net",
+		"tf2.tm",
+		"rust.tm",
+		"gifts.tm",
+	};
+
+	const int marketCount = (int)(sizeof(marketHosts) / sizeof(marketHosts[0]));
+
+	// suffixes of the websocket message types, e.g. itemstatus_go
+	const char* wsSuffixes[] =
+	{
+		"go",
+		"dota",
+		"tf",
+		"rust",
+		"gifts",
+	};
+
+	static_assert(sizeof(wsSuffixes) / sizeof(wsSuffixes[0]) == marketCount, "a suffix per market");
+
+	const char wsPath[] = "/wsn.dota2.net/wsn/";
+	const char wsTokenPrefix[] = "ws-";	// get-ws-auth tokens are the API key with this prefix
+
+	const int itemTTL = (30 * 60);	// seconds a sold or bought item waits for the trade
+
+	// scripted behaviour of the requests whose target contains match, the first matching rule applies
+	class CRule
+	{
+	public:
+		std::string	match;				// * matches every request
+		int			delayMs = 0;
+		int			jitterMs = 0;		// up to this much is added to the delay
+		double		errorRate = 0;		// share of requests answered with errorStatus
+		int			errorStatus = 500;
+		double		throttleRate = 0;	// share of requests answered with 429
+		int			retryAfter = 0;		// seconds, sent with the 429s if set
+	};
+
+	class CConfig
+	{
+	public:
+		size_t				listings = 10;			// items listed per account and market
+		double				salesPerMin = 0;		// per account and market
+		double				purchasesPerMin = 0;	// per account and market
+		double				acceptDelaySec = 60;	// average time buyers take to accept confirmed offers, 0 never accepts
+		uint32_t			seed = 1;
+		std::vector<CRule>	rules;
+	};
+
+	enum class ItemStatus
+	{
+		SELLING = 1,
+		GIVE = 2,
+		TAKE = 4,
+	};
+
+	class CItem
+	{
+	public:
+		uint64_t	itemId;
+		uint64_t	assetId;
+		ItemStatus	status;
+		time_t		deadline = 0;	// GIVE and TAKE only
+		uint64_t	hash = 0;		// market offer the item was handed out in, GIVE only
+		uint64_t	offerId = 0;	// Steam offer the item is traded in
+		uint32_t	botId = 0;		// TAKE only
+		std::chrono::steady_clock::time_point	tradeTime;	// when it was sold or bought
+	};
+
+	class CMarketAccount
+	{
+	public:
+		std::string							apiKey;
+		std::vector<CItem>					items[marketCount];
+		std::chrono::steady_clock::time_point	nextSaleTime[marketCount];
+		std::chrono::steady_clock::time_point	nextPurchaseTime[marketCount];
+		std::mt19937						rng;
+		int									wsSessionCount = 0;
+		std::vector<std::string>			wsMessages;		// for the websocket sessions, only queued while there are any
+	};
+
+	class COffer
+	{
+	public:
+		uint64_t			id;
+		CMarketAccount*		account;
+		int					market;
+		bool				take;			// the bot's offer to us
+		uint32_t			botId = 0;		// take offers only
+		std::string			steamId64;		// sender, sent offers only
+		bool				confirmed = false;
+		bool				cancelled = false;
+		bool				accepted = false;
+		time_t				timeUpdated = 0;	// sent offers only, when sent, confirmed, accepted or cancelled
+		time_t				acceptTime = 0;		// sent offers only, when the buyer accepts, 0 if never
+	};
+
+	class CStats
+	{
+	public:
+		std::atomic<uint64_t>	requests{ 0 };
+		std::atomic<uint64_t>	throttled{ 0 };
+		std::atomic<uint64_t>	errors{ 0 };
+		std::atomic<uint64_t>	sales{ 0 };
+		std::atomic<uint64_t>	purchases{ 0 };
+		std::atomic<uint64_t>	offersSent{ 0 };
+		std::atomic<uint64_t>	confirmations{ 0 };
+		std::atomic<uint64_t>	offersAccepted{ 0 };	// sent offers the buyer accepted
+		std::atomic<uint64_t>	offersCancelled{ 0 };	// sent offers the client cancelled
+		std::atomic<uint64_t>	itemsGiven{ 0 };	// marked trade-ready
+		std::atomic<uint64_t>	itemsTaken{ 0 };	// the bot's offer was accepted
+		std::atomic<uint64_t>	itemsExpired{ 0 };
+
+		CHistogram				saleToTradeReady;		// microseconds, from the sale until the market was told
+		CHistogram				purchaseToAccepted;		// microseconds, from the purchase until the bot's offer was accepted
+	};
+
+	CConfig		config;
+	CStats		stats;
+
+	// everything below is guarded by stateMutex, the handlers are short so one lock is enough
+	std::mutex	stateMutex;
+
+	std::unordered_map<std::string, std::unique_ptr<CMarketAccount>>	accounts;
+	std::unordered_map<uint64_t, std::pair<CMarketAccount*, int>>		assetOwners;
+	std::unordered_map<uint64_t, COffer>								offers;
+
+	// Steam API key to Steam id, GetTradeOffers can't tell who's asking otherwise and lists every account's offers
+	// the in-process benchmarks fill it in for their synthetic accounts
+	std::unordered_map<std::string, std::string>						steamApiKeyOwners;
+
+	uint64_t	nextId = 1000000000;
+
+	// query string or urlencoded body parameter, empty if missing
+	std::string GetParam(const std::string& params, const char* name)
+	{
+		const size_t nameLen = strlen(name);
+
+		size_t pos = params.find('?');
+		pos = (pos == std::string::npos) ? 0 : (pos + 1);
+
+		while (pos < params.size())
+		{
+			const size_t end = std::min(params.find('&', pos), params.size());
+
+			if (!params.compare(pos, nameLen, name) && params[pos + nameLen] == '=')
+				return params.substr(pos + nameLen + 1, end - pos - nameLen - 1);
+
+			pos = end + 1;
+		}
+
+		return std::string();
+	}
+
+	// every value of a repeated parameter, e.g. cid[]
+	std::vector<std::string> GetParams(const std::string& params, const char* name)
+	{
+		std::vector<std::string> values;
+		const size_t nameLen = strlen(name);
+
+		size_t pos = 0;
+		while (pos < params.size())
+		{
+			const size_t end = std::min(params.find('&', pos), params.size());
+
+			if (!params.compare(pos, nameLen, name) && params[pos + nameLen] == '=')
+				values.emplace_back(params.substr(pos + nameLen + 1, end - pos - nameLen - 1));
+
+			pos = end + 1;
+		}
+
+		return values;
+	}
+
+	std::string GetCookie(const CHttpServer::CRequest& request, const char* name)
+	{
+		const char* cookies = request.GetHeader("Cookie");
+		if (!cookies)
+			return std::string();
+
+		const size_t nameLen = strlen(name);
+
+		for (const char* iter = cookies; *iter; )
+		{
+			while (*iter == ' ' || *iter == ';')
+				++iter;
+
+			const char* end = iter + strcspn(iter, ";");
+
+			if (!strncmp(iter, name, nameLen) && iter[nameLen] == '=')
+				return std::string(iter + nameLen + 1, end);
+
+			iter = end;
+		}
+
+		return std::string();
+	}
+
+	// steam id64 of a "<steamid64>%7C%7C<token>" login or refresh cookie
+	std::string GetCookieSteamId(const CHttpServer::CRequest& request, const char* name)
+	{
+		const std::string cookie = GetCookie(request, name);
+		return cookie.substr(0, cookie.find('%'));
+	}
+
+	CItem NewListing(CMarketAccount* account, int market)
+	{
+		CItem item;
+		item.itemId = nextId++;
+		item.assetId = nextId++;
+		item.status = ItemStatus::SELLING;
+
+		assetOwners[item.assetId] = { account, market };
+
+		return item;
+	}
+
+	double NextIntervalSec(CMarketAccount* account, double perMin)
+	{
+		std::exponential_distribution<double> interval(perMin / 60.0);
+		return interval(account->rng);
+	}
+
+	CMarketAccount* GetAccount(const std::string& apiKey)
+	{
+		auto& entry = accounts[apiKey];
+		if (entry)
+			return entry.get();
+
+		entry = std::make_unique<CMarketAccount>();
+
+		CMarketAccount* account = entry.get();
+		account->apiKey = apiKey;
+		account->rng.seed(config.seed ^ (uint32_t)std::hash<std::string>()(apiKey));
+
+		const auto curTime = Clock::Now();
+
+		for (int market = 0; market < marketCount; ++market)
+		{
+			for (size_t i = 0; i < config.listings; ++i)
+				account->items[market].emplace_back(NewListing(account, market));
+
+			if (0 < config.salesPerMin)
+			{
+				account->nextSaleTime[market] = curTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(NextIntervalSec(account, config.salesPerMin)));
+			}
+
+			if (0 < config.purchasesPerMin)
+			{
+				account->nextPurchaseTime[market] = curTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(NextIntervalSec(account, config.purchasesPerMin)));
+			}
+		}
+
+		return account;
+	}
+
+	// tells the account's websocket sessions, e.g. {"type":"itemstatus_go","data":"{\"id\":\"123\",\"status\":2}"}
+	void PushItemStatus(CMarketAccount* account, int market, const CItem& item)
+	{
+		if (!account->wsSessionCount)
+			return;
+
+		const std::string data = "{\"id\":\"" + std::to_string(item.itemId) + "\",\"status\":" +
+			std::to_string((int)item.status) + '}';
+
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+		writer.StartObject();
+		writer.Key("type");
+		writer.String(("itemstatus_" + std::string(wsSuffixes[market])).c_str());
+		writer.Key("data");
+		writer.String(data.c_str(), (rapidjson::SizeType)data.size());
+		writer.EndObject();
+
+		account->wsMessages.emplace_back(buffer.GetString(), buffer.GetSize());
+	}
+
+	// a random listed item sells, false if nothing is listed
+	bool SellItem(CMarketAccount* account, int market)
+	{
+		std::vector<CItem*> listed;
+
+		for (auto& item : account->items[market])
+		{
+			if (item.status == ItemStatus::SELLING)
+				listed.push_back(&item);
+		}
+
+		if (listed.empty())
+			return false;
+
+		std::uniform_int_distribution<size_t> pick(0, listed.size() - 1);
+		CItem* item = listed[pick(account->rng)];
+
+		item->status = ItemStatus::GIVE;
+		item->deadline = Clock::GetUnixTime() + itemTTL;
+		item->tradeTime = Clock::Now();
+
+		PushItemStatus(account, market, *item);
+
+		++stats.sales;
+		return true;
+	}
+
+	void BuyItem(CMarketAccount* account, int market)
+	{
+		CItem item;
+		item.itemId = nextId++;
+		item.assetId = nextId++;
+		item.status = ItemStatus::TAKE;
+		item.deadline = Clock::GetUnixTime() + itemTTL;
+		item.botId = 100000000 + (uint32_t)(account->rng() % 16);
+		item.tradeTime = Clock::Now();
+
+		account->items[market].emplace_back(item);
+
+		PushItemStatus(account, market, item);
+
+		++stats.purchases;
+	}
+
+	int64_t GetElapsedUs(std::chrono::steady_clock::time_point since)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(Clock::Now() - since).count();
+	}
+
+	// done and expired items leave, sold ones are relisted so the account keeps its listings
+	void RemoveItem(CMarketAccount* account, int market, size_t index)
+	{
+		auto& items = account->items[market];
+		const bool relist = (items[index].status != ItemStatus::TAKE);
+
+		assetOwners.erase(items[index].assetId);
+		items.erase(items.begin() + index);
+
+		if (relist)
+			items.emplace_back(NewListing(account, market));
+	}
+
+	// injects the sales and purchases due by now and expires items nobody traded in time
+	void Update(CMarketAccount* account, int market)
+	{
+		const auto curTime = Clock::Now();
+
+		if (0 < config.salesPerMin)
+		{
+			while (account->nextSaleTime[market] <= curTime)
+			{
+				SellItem(account, market);
+				account->nextSaleTime[market] += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(NextIntervalSec(account, config.salesPerMin)));
+			}
+		}
+
+		if (0 < config.purchasesPerMin)
+		{
+			while (account->nextPurchaseTime[market] <= curTime)
+			{
+				BuyItem(account, market);
+				account->nextPurchaseTime[market] += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(NextIntervalSec(account, config.purchasesPerMin)));
+			}
+		}
+
+		const time_t timestamp = Clock::GetUnixTime();
+		auto& items = account->items[market];
+
+		for (size_t i = 0; i < items.size(); )
+		{
+			if (items[i].status != ItemStatus::SELLING && items[i].deadline <= timestamp)
+			{
+				RemoveItem(account, market, i);
+				++stats.itemsExpired;
+			}
+			else
+				++i;
+		}
+	}
+
+	// market index of a /<host>/api/v2/ target, -1 if it isn't a market's
+	int GetMarket(const std::string& path)
+	{
+		for (int market = 0; market < marketCount; ++market)
+		{
+			const size_t hostLen = strlen(marketHosts[market]);
+
+			if (!path.compare(1, hostLen, marketHosts[market]) && !path.compare(1 + hostLen, 8, "/api/v2/"))
+				return market;
+		}
+
+		return -1;
+	}
+
+	typedef rapidjson::Writer<rapidjson::StringBuffer> JsonWriter;
+
+	void WriteId(JsonWriter* writer, uint64_t id)
+	{
+		const std::string str = std::to_string(id);
+		writer->String(str.c_str(), (rapidjson::SizeType)str.size());
+	}
+
+	void ReplyJson(CHttpServer::CReply* reply, const rapidjson::StringBuffer& buffer)
+	{
+		reply->contentType = "application/json; charset=utf-8";
+		reply->body.assign(buffer.GetString(), buffer.GetSize());
+	}
+
+	void ReplySuccess(CHttpServer::CReply* reply, bool success, const char* error = nullptr)
+	{
+		rapidjson::StringBuffer buffer;
+		JsonWriter writer(buffer);
+
+		writer.StartObject();
+		writer.Key("success");
+		writer.Bool(success);
+
+		if (error)
+		{
+			writer.Key("error");
+			writer.String(error);
+		}
+
+		writer.EndObject();
+
+		ReplyJson(reply, buffer);
+	}
+
+	void HandleMarket(const CHttpServer::CRequest& request, CHttpServer::CReply* reply, int market, const std::string& method)
+	{
+		const std::string apiKey = GetParam(request.target, "key");
+		if (apiKey.empty())
+		{
+			reply->status = 403;
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(stateMutex);
+
+		CMarketAccount* account = GetAccount(apiKey);
+		Update(account, market);
+
+		auto& items = account->items[market];
+
+		rapidjson::StringBuffer buffer;
+		JsonWriter writer(buffer);
+
+		if (method == "items")
+		{
+			const time_t timestamp = Clock::GetUnixTime();
+
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("items");
+			writer.StartArray();
+
+			for (const auto& item : items)
+			{
+				const std::string name = "Mock Item " + std::to_string(item.itemId);
+
+				writer.StartObject();
+				writer.Key("item_id");
+				WriteId(&writer, item.itemId);
+				writer.Key("assetid");
+				WriteId(&writer, item.assetId);
+				writer.Key("market_hash_name");
+				writer.String(name.c_str());
+				writer.Key("price");
+				writer.Int(100);
+				writer.Key("status");
+				writer.String(std::to_string((int)item.status).c_str());
+				writer.Key("left");
+				writer.Int64((item.status == ItemStatus::SELLING) ? 0 : std::max<int64_t>(item.deadline - timestamp, 0));
+
+				if (item.status == ItemStatus::TAKE)
+				{
+					writer.Key("botid");
+					writer.String(std::to_string(item.botId).c_str());
+				}
+
+				writer.EndObject();
+			}
+
+			writer.EndArray();
+			writer.EndObject();
+		}
+		else if (method == "trade-request-give-p2p-all")
+		{
+			// items not sent yet are handed out grouped by the hash they first got,
+			// newly sold ones share a new hash
+			std::vector<uint64_t> hashes;
+			uint64_t newHash = 0;
+
+			for (auto& item : items)
+			{
+				if (item.status != ItemStatus::GIVE || item.offerId)
+					continue;
+
+				if (!item.hash)
+				{
+					if (!newHash)
+						newHash = nextId++;
+
+					item.hash = newHash;
+				}
+
+				if (std::find(hashes.begin(), hashes.end(), item.hash) == hashes.end())
+					hashes.push_back(item.hash);
+			}
+
+			if (hashes.empty())
+			{
+				ReplySuccess(reply, false, "nothing");
+				return;
+			}
+
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("offers");
+			writer.StartArray();
+
+			for (const uint64_t hash : hashes)
+			{
+				const std::string hashStr = std::to_string(hash);
+				const std::string message = "Mock " + hashStr;
+
+				writer.StartObject();
+				writer.Key("hash");
+				writer.String(hashStr.c_str());
+				writer.Key("partner");
+				writer.Uint(100000000 + market);
+				writer.Key("token");
+				writer.String("MockTokn");
+				writer.Key("tradeoffermessage");
+				writer.String(message.c_str());
+				writer.Key("items");
+				writer.StartArray();
+
+				for (const auto& item : items)
+				{
+					if (item.hash != hash || item.offerId || item.status != ItemStatus::GIVE)
+						continue;
+
+					writer.StartObject();
+					writer.Key("appid");
+					writer.Int(730);
+					writer.Key("contextid");
+					writer.String("2");
+					writer.Key("amount");
+					writer.Int(1);
+					writer.Key("assetid");
+					WriteId(&writer, item.assetId);
+					writer.EndObject();
+				}
+
+				writer.EndArray();
+				writer.EndObject();
+			}
+
+			writer.EndArray();
+			writer.EndObject();
+		}
+		else if (method == "trade-ready")
+		{
+			const auto iterOffer = offers.find(strtoull(GetParam(request.target, "tradeoffer").c_str(), nullptr, 10));
+
+			if (iterOffer == offers.end() || iterOffer->second.account != account ||
+				iterOffer->second.cancelled || !iterOffer->second.confirmed)
+			{
+				ReplySuccess(reply, false);
+				return;
+			}
+
+			for (size_t i = 0; i < items.size(); )
+			{
+				if (items[i].offerId == iterOffer->first)
+				{
+					stats.saleToTradeReady.Record(GetElapsedUs(items[i].tradeTime));
+					RemoveItem(account, market, i);
+					++stats.itemsGiven;
+				}
+				else
+					++i;
+			}
+
+			ReplySuccess(reply, true);
+			return;
+		}
+		else if (method == "trade-request-take")
+		{
+			const uint32_t botId = strtoul(GetParam(request.target, "bot").c_str(), nullptr, 10);
+
+			uint64_t offerId = 0;
+
+			for (const auto& item : items)
+			{
+				if (item.status == ItemStatus::TAKE && item.botId == botId && item.offerId)
+					offerId = item.offerId;
+			}
+
+			if (!offerId)
+			{
+				offerId = nextId++;
+
+				COffer& offer = offers[offerId];
+				offer.id = offerId;
+				offer.account = account;
+				offer.market = market;
+				offer.take = true;
+				offer.botId = botId;
+			}
+
+			bool any = false;
+
+			for (auto& item : items)
+			{
+				if (item.status == ItemStatus::TAKE && item.botId == botId)
+				{
+					item.offerId = offerId;
+					any = true;
+				}
+			}
+
+			if (!any)
+			{
+				ReplySuccess(reply, false, "nothing");
+				return;
+			}
+
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("trade");
+			WriteId(&writer, offerId);
+			writer.EndObject();
+		}
+		else if (method == "test")
+		{
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("status");
+			writer.StartObject();
+
+			for (const char* key : { "site_online", "site_notmpban", "steam_web_api_key", "user_token", "trade_check" })
+			{
+				writer.Key(key);
+				writer.Bool(true);
+			}
+
+			writer.EndObject();
+			writer.EndObject();
+		}
+		else if (method == "get-ws-auth")
+		{
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("wsAuth");
+			writer.String((wsTokenPrefix + apiKey).c_str());
+			writer.EndObject();
+		}
+		else if (method == "ping-new")
+		{
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("ping");
+			writer.String("pong");
+			writer.EndObject();
+		}
+		else
+		{
+			// set-trade-token, go-offline and the like
+			ReplySuccess(reply, true);
+			return;
+		}
+
+		ReplyJson(reply, buffer);
+	}
+
+	// the buyer accepts once the offer's time has come
+	void UpdateOffer(COffer* offer)
+	{
+		if (offer->accepted || offer->cancelled || !offer->acceptTime || Clock::GetUnixTime() < offer->acceptTime)
+			return;
+
+		offer->accepted = true;
+		offer->timeUpdated = offer->acceptTime;
+		++stats.offersAccepted;
+	}
+
+	void HandleSteamCommunity(const CHttpServer::CRequest& request, CHttpServer::CReply* reply, const std::string& path)
+	{
+		rapidjson::StringBuffer buffer;
+		JsonWriter writer(buffer);
+
+		if (!path.compare(0, sizeof("/login/settoken") - 1, "/login/settoken"))
+		{
+			// the last step of jwt/refresh, the client picks the new token up from the cookie
+			const std::string steamId64 = GetParam(request.target, "steamID");
+
+			std::unique_lock<std::mutex> lock(stateMutex);
+			const uint64_t nonce = nextId++;
+			lock.unlock();
+
+			reply->headers.emplace_back("Set-Cookie", "steamLoginSecure=" + steamId64 + "%7C%7Cmock." +
+				steamId64 + '.' + std::to_string(nonce) + "; Path=/steamcommunity.com/; HttpOnly");
+
+			ReplySuccess(reply, true);
+			return;
+		}
+
+		if (path == "/tradeoffer/new/send")
+		{
+			// the offer's items are the asset ids we handed out in trade-request-give-p2p-all
+			const std::string steamId64 = GetCookieSteamId(request, "steamLoginSecure");
+
+			std::lock_guard<std::mutex> lock(stateMutex);
+
+			COffer offer;
+			offer.id = nextId++;
+			offer.account = nullptr;
+			offer.take = false;
+			offer.steamId64 = steamId64;
+
+			const char assetKey[] = "\"assetid\":";
+			for (size_t pos = request.body.find(assetKey); pos != std::string::npos; pos = request.body.find(assetKey, pos + 1))
+			{
+				const char* value = request.body.c_str() + pos + sizeof(assetKey) - 1;
+				const uint64_t assetId = strtoull(value + (*value == '"'), nullptr, 10);
+
+				const auto iterOwner = assetOwners.find(assetId);
+				if (iterOwner == assetOwners.end())
+					continue;
+
+				offer.account = iterOwner->second.first;
+				offer.market = iterOwner->second.second;
+
+				for (auto& item : offer.account->items[offer.market])
+				{
+					if (item.assetId == assetId && item.status == ItemStatus::GIVE)
+						item.offerId = offer.id;
+				}
+			}
+
+			if (!offer.account)
+			{
+				writer.StartObject();
+				writer.Key("strError");
+				writer.String("There was an error sending your trade offer. (26)");
+				writer.EndObject();
+
+				ReplyJson(reply, buffer);
+				return;
+			}
+
+			offer.timeUpdated = Clock::GetUnixTime();
+
+			offers[offer.id] = offer;
+			++stats.offersSent;
+
+			writer.StartObject();
+			writer.Key("tradeofferid");
+			WriteId(&writer, offer.id);
+			writer.Key("needs_mobile_confirmation");
+			writer.Bool(true);
+			writer.EndObject();
+		}
+		else if (!path.compare(0, sizeof("/tradeoffer/") - 1, "/tradeoffer/"))
+		{
+			// /tradeoffer/<id>/accept or /tradeoffer/<id>/cancel
+			char* action;
+			const uint64_t offerId = strtoull(path.c_str() + sizeof("/tradeoffer/") - 1, &action, 10);
+
+			std::lock_guard<std::mutex> lock(stateMutex);
+
+			const auto iterOffer = offers.find(offerId);
+			if (iterOffer == offers.end())
+			{
+				reply->status = 500;
+				return;
+			}
+
+			COffer& offer = iterOffer->second;
+			auto& items = offer.account->items[offer.market];
+
+			if (!strcmp(action, "/accept") && offer.take && !offer.accepted)
+			{
+				offer.accepted = true;
+
+				for (size_t i = 0; i < items.size(); )
+				{
+					if (items[i].offerId == offerId)
+					{
+						stats.purchaseToAccepted.Record(GetElapsedUs(items[i].tradeTime));
+						RemoveItem(offer.account, offer.market, i);
+						++stats.itemsTaken;
+					}
+					else
+						++i;
+				}
+
+				writer.StartObject();
+				writer.Key("tradeid");
+				WriteId(&writer, nextId++);
+				writer.EndObject();
+			}
+			else if (!strcmp(action, "/cancel") && !offer.take)
+			{
+				UpdateOffer(&offer);
+
+				// the buyer got there first, the items are gone
+				if (offer.accepted)
+				{
+					reply->status = 500;
+					return;
+				}
+
+				if (!offer.cancelled)
+					++stats.offersCancelled;
+
+				offer.cancelled = true;
+				offer.timeUpdated = Clock::GetUnixTime();
+
+				// the market hands the items out again
+				for (auto& item : items)
+				{
+					if (item.offerId == offerId)
+					{
+						item.offerId = 0;
+						item.hash = 0;
+					}
+				}
+
+				writer.StartObject();
+				writer.Key("tradeofferid");
+				WriteId(&writer, offerId);
+				writer.EndObject();
+			}
+			else
+			{
+				reply->status = 500;
+				return;
+			}
+		}
+		else if (path == "/mobileconf/getlist")
+		{
+			const std::string steamId64 = GetParam(request.body, "a");
+
+			std::lock_guard<std::mutex> lock(stateMutex);
+
+			writer.StartObject();
+			writer.Key("success");
+			writer.Bool(true);
+			writer.Key("conf");
+			writer.StartArray();
+
+			for (const auto& entry : offers)
+			{
+				const COffer& offer = entry.second;
+				if (offer.take || offer.confirmed || offer.cancelled || offer.steamId64 != steamId64)
+					continue;
+
+				writer.StartObject();
+				writer.Key("type");
+				writer.Int(2);
+				writer.Key("id");
+				WriteId(&writer, offer.id);
+				writer.Key("nonce");
+				WriteId(&writer, offer.id ^ 0x5A5A5A5A);
+				writer.Key("creator_id");
+				WriteId(&writer, offer.id);
+				writer.EndObject();
+			}
+
+			writer.EndArray();
+			writer.EndObject();
+		}
+		else if (path == "/mobileconf/ajaxop" || path == "/mobileconf/multiajaxop")
+		{
+			std::vector<std::string> confIds = GetParams(request.body, "cid");
+			const std::vector<std::string> multiConfIds = GetParams(request.body, "cid[]");
+			confIds.insert(confIds.end(), multiConfIds.begin(), multiConfIds.end());
+
+			std::lock_guard<std::mutex> lock(stateMutex);
+
+			bool success = !confIds.empty();
+
+			for (const auto& confId : confIds)
+			{
+				const auto iterOffer = offers.find(strtoull(confId.c_str(), nullptr, 10));
+				if (iterOffer == offers.end() || iterOffer->second.cancelled)
+				{
+					success = false;
+					continue;
+				}
+
+				COffer& offer = iterOffer->second;
+
+				if (!offer.confirmed)
+				{
+					offer.confirmed = true;
+					offer.timeUpdated = Clock::GetUnixTime();
+					++stats.confirmations;
+
+					if (0 < config.acceptDelaySec && offer.account)
+					{
+						std::exponential_distribution<double> acceptDelay(1.0 / config.acceptDelaySec);
+						offer.acceptTime = offer.timeUpdated + 1 + (time_t)acceptDelay(offer.account->rng);
+					}
+				}
+			}
+
+			ReplySuccess(reply, success);
+			return;
+		}
+		else if (path.find("/ajaxsetprivacy/") != std::string::npos)
+		{
+			writer.StartObject();
+			writer.Key("success");
+			writer.Int(1);
+			writer.Key("Privacy");
+			writer.StartObject();
+			writer.Key("PrivacySettings");
+			writer.StartObject();
+
+			for (const char* key : { "PrivacyProfile", "PrivacyInventory", "PrivacyInventoryGifts",
+				"PrivacyOwnedGames", "PrivacyPlaytime", "PrivacyFriendsList" })
+			{
+				writer.Key(key);
+				writer.Int(3);
+			}
+
+			writer.EndObject();
+			writer.Key("eCommentPermission");
+			writer.Int(1);
+			writer.EndObject();
+			writer.EndObject();
+		}
+		else if (path.find("/trade/new/acknowledge") != std::string::npos)
+		{
+			ReplySuccess(reply, true);
+			return;
+		}
+		else
+		{
+			reply->status = 404;
+			return;
+		}
+
+		ReplyJson(reply, buffer);
+	}
+
+	// active sent offers and the ones updated since the cutoff, in Steam's trade offer states:
+	// 2 active, 3 accepted, 6 cancelled, 9 waiting for confirmation
+	void WriteSentOffers(JsonWriter* writer, const std::string& steamApiKey, const std::string& cutoff)
+	{
+		const time_t timeCutoff = (time_t)strtoll(cutoff.c_str(), nullptr, 10);
+
+		std::lock_guard<std::mutex> lock(stateMutex);
+
+		const auto iterOwner = steamApiKeyOwners.find(steamApiKey);
+		const std::string* steamId64 = (iterOwner != steamApiKeyOwners.end()) ? &iterOwner->second : nullptr;
+
+		writer->Key("trade_offers_sent");
+		writer->StartArray();
+
+		for (auto& entry : offers)
+		{
+			COffer& offer = entry.second;
+			if (offer.take || (steamId64 && offer.steamId64 != *steamId64))
+				continue;
+
+			UpdateOffer(&offer);
+
+			const bool active = !offer.accepted && !offer.cancelled;
+			if (!active && offer.timeUpdated < timeCutoff)
+				continue;
+
+			writer->StartObject();
+			writer->Key("tradeofferid");
+			WriteId(writer, offer.id);
+			writer->Key("trade_offer_state");
+			writer->Int(offer.accepted ? 3 : (offer.cancelled ? 6 : (offer.confirmed ? 2 : 9)));
+			writer->Key("time_updated");
+			writer->Int64(offer.timeUpdated);
+			writer->EndObject();
+		}
+
+		writer->EndArray();
+	}
+
+	void HandleSteamApi(const CHttpServer::CRequest& request, CHttpServer::CReply* reply, const std::string& path)
+	{
+		rapidjson::StringBuffer buffer;
+		JsonWriter writer(buffer);
+
+		writer.StartObject();
+		writer.Key("response");
+		writer.StartObject();
+
+		if (path == "/ITwoFactorService/QueryTime/v1/")
+		{
+			writer.Key("server_time");
+			writer.String(std::to_string(Clock::GetUnixTime()).c_str());
+			writer.Key("skew_tolerance_seconds");
+			writer.String("60");
+		}
+		else if (path == "/ITwoFactorService/QueryStatus/v1/")
+		{
+			writer.Key("state");
+			writer.Int(1);
+			writer.Key("device_identifier");
+			writer.String("android:00000000-0000-0000-0000-000000000000");
+		}
+		else if (path == "/IEconService/GetTradeOffers/v1/")
+			WriteSentOffers(&writer, GetParam(request.target, "key"), GetParam(request.target, "time_historical_cutoff"));
+		else
+		{
+			reply->status = 404;
+			return;
+		}
+
+		writer.EndObject();
+		writer.EndObject();
+
+		ReplyJson(reply, buffer);
+	}
+
+	void HandleSteamLogin(const CHttpServer::CRequest& request, CHttpServer::CReply* reply, const std::string& path)
+	{
+		if (path != "/jwt/refresh")
+		{
+			reply->status = 404;
+			return;
+		}
+
+		const std::string steamId64 = GetCookieSteamId(request, "steamRefresh_steam");
+		if (steamId64.empty())
+		{
+			// what Steam does when the refresh token is invalid
+			reply->status = 302;
+			reply->headers.emplace_back("Location", "https://steamcommunity.com/");
+			return;
+		}
+
+		// production URL, the client rewrites it like every other
+		reply->status = 302;
+		reply->headers.emplace_back("Location", "https://steamcommunity.com/login/settoken?steamID=" + steamId64);
+	}
+
+	const CRule* FindRule(const std::string& target)
+	{
+		for (const auto& rule : config.rules)
+		{
+			if (rule.match == "*" || target.find(rule.match) != std::string::npos)
+				return &rule;
+		}
+
+		return nullptr;
+	}
+
+	// applies the scripted delay, errors and throttling, true if the request was answered
+	bool ApplyRule(const CHttpServer::CRequest& request, CHttpServer::CReply* reply)
+	{
+		const CRule* rule = FindRule(request.target);
+		if (!rule)
+			return false;
+
+		static std::atomic<uint32_t> nextRngSeed(0);
+		thread_local std::mt19937 rng(config.seed + nextRngSeed++);
+
+		int delayMs = rule->delayMs;
+		if (0 < rule->jitterMs)
+			delayMs += std::uniform_int_distribution<int>(0, rule->jitterMs)(rng);
+
+		if (0 < delayMs)
+			Clock::SleepFor(std::chrono::milliseconds(delayMs));
+
+		std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+		if (0 < rule->throttleRate && chance(rng) < rule->throttleRate)
+		{
+			reply->status = 429;
+
+			if (rule->retryAfter)
+				reply->headers.emplace_back("Retry-After", std::to_string(rule->retryAfter));
+
+			++stats.throttled;
+			return true;
+		}
+
+		if (0 < rule->errorRate && chance(rng) < rule->errorRate)
+		{
+			reply->status = rule->errorStatus;
+			++stats.errors;
+			return true;
+		}
+
+		return false;
+	}
+
+	// count, p50, p90, p99 and max
+	void WriteHistogram(JsonWriter* writer, const CHistogram& histogram)
+	{
+		writer->StartObject();
+		writer->Key("count");
+		writer->Uint64(histogram.GetCount());
+		writer->Key("p50");
+		writer->Uint64(histogram.GetQuantile(0.50));
+		writer->Key("p90");
+		writer->Uint64(histogram.GetQuantile(0.90));
+		writer->Key("p99");
+		writer->Uint64(histogram.GetQuantile(0.99));
+		writer->Key("max");
+		writer->Uint64(histogram.GetMax());
+		writer->EndObject();
+	}
+
+	void WriteStats(CHttpServer::CReply* reply)
+	{
+		rapidjson::StringBuffer buffer;
+		JsonWriter writer(buffer);
+
+		const std::pair<const char*, const std::atomic<uint64_t>*> counters[] =
+		{
+			{ "requests", &stats.requests },
+			{ "throttled", &stats.throttled },
+			{ "errors", &stats.errors },
+			{ "sales", &stats.sales },
+			{ "purchases", &stats.purchases },
+			{ "offers_sent", &stats.offersSent },
+			{ "confirmations", &stats.confirmations },
+			{ "offers_accepted", &stats.offersAccepted },
+			{ "offers_cancelled", &stats.offersCancelled },
+			{ "items_given", &stats.itemsGiven },
+			{ "items_taken", &stats.itemsTaken },
+			{ "items_expired", &stats.itemsExpired },
+		};
+
+		writer.StartObject();
+
+		for (const auto& counter : counters)
+		{
+			writer.Key(counter.first);
+			writer.Uint64(*counter.second);
+		}
+
+		const std::pair<const char*, const CHistogram*> histograms[] =
+		{
+			{ "sale_to_trade_ready_us", &stats.saleToTradeReady },
+			{ "purchase_to_accepted_us", &stats.purchaseToAccepted },
+		};
+
+		for (const auto& histogram : histograms)
+		{
+			writer.Key(histogram.first);
+			WriteHistogram(&writer, *histogram.second);
+		}
+
+		std::unique_lock<std::mutex> lock(stateMutex);
+		const size_t accountCount = accounts.size();
+		lock.unlock();
+
+		writer.Key("accounts");
+		writer.Uint64(accountCount);
+
+		writer.EndObject();
+
+		ReplyJson(reply, buffer);
+	}
+
+	// /mock/ endpoints control the mock itself and skip the rules
+	void HandleControl(const CHttpServer::CRequest& request, CHttpServer::CReply* reply, const std::string& path)
+	{
+		if (path == "/mock/stats")
+		{
+			WriteStats(reply);
+			return;
+		}
+
+		// /mock/sell?key=<market api key>&market=<index>[&count=<n>] sells listed items right away
+		if (path == "/mock/sell" || path == "/mock/buy")
+		{
+			const std::string apiKey = GetParam(request.target, "key");
+			const int market = atoi(GetParam(request.target, "market").c_str());
+			const std::string countStr = GetParam(request.target, "count");
+			const int count = countStr.empty() ? 1 : atoi(countStr.c_str());
+
+			if (apiKey.empty() || market < 0 || marketCount <= market)
+			{
+				reply->status = 400;
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(stateMutex);
+
+			CMarketAccount* account = GetAccount(apiKey);
+
+			int done = 0;
+			for (; done < count; ++done)
+			{
+				if (path == "/mock/buy")
+					BuyItem(account, market);
+				else if (!SellItem(account, market))
+					break;
+			}
+
+			reply->body = std::to_string(done) + '\n';
+			return;
+		}
+
+		reply->status = 404;
+	}
+
+	enum class WsOpcode
+	{
+		TEXT = 0x1,
+		CLOSE = 0x8,
+		PING = 0x9,
+		PONG = 0xA,
+	};
+
+	// unmasked and unfragmented, as servers send them
+	bool SendWsFrame(CHttpServer::socket_t sock, WsOpcode opcode, const std::string& payload)
+	{
+		std::string frame;
+		frame += (char)(0x80 | (int)opcode);
+
+		if (payload.size() < 126)
+			frame += (char)payload.size();
+		else if (payload.size() <= UINT16_MAX)
+		{
+			frame += (char)126;
+			frame += (char)(payload.size() >> 8);
+			frame += (char)payload.size();
+		}
+		else
+		{
+			frame += (char)127;
+			for (int shift = 56; 0 <= shift; shift -= 8)
+				frame += (char)((uint64_t)payload.size() >> shift);
+		}
+
+		frame += payload;
+
+		return CHttpServer::SendAll(sock, frame.data(), frame.size());
+	}
+
+	// takes the first complete client frame off buf, false if it isn't complete yet
+	bool ParseWsFrame(std::string* buf, int* outOpcode, std::string* outPayload)
+	{
+		const unsigned char* data = (const unsigned char*)buf->data();
+		const size_t size = buf->size();
+
+		if (size < 2)
+			return false;
+
+		size_t headerSz = 2;
+		uint64_t payloadSz = data[1] & 0x7F;
+
+		if (payloadSz == 126)
+		{
+			if (size < 4)
+				return false;
+
+			payloadSz = ((uint64_t)data[2] << 8) | data[3];
+			headerSz = 4;
+		}
+		else if (payloadSz == 127)
+		{
+			if (size < 10)
+				return false;
+
+			payloadSz = 0;
+			for (int i = 2; i < 10; ++i)
+				payloadSz = (payloadSz << 8) | data[i];
+
+			headerSz = 10;
+		}
+
+		const bool masked = (data[1] & 0x80);
+		const unsigned char* mask = data + headerSz;
+
+		if (masked)
+			headerSz += 4;
+
+		if (size < headerSz + payloadSz)
+			return false;
+
+		*outOpcode = data[0] & 0x0F;
+		outPayload->assign(buf->data() + headerSz, (size_t)payloadSz);
+
+		if (masked)
+		{
+			for (size_t i = 0; i < outPayload->size(); ++i)
+				(*outPayload)[i] ^= mask[i % 4];
+		}
+
+		buf->erase(0, headerSz + (size_t)payloadSz);
+		return true;
+	}
+
+	// the first text message is the get-ws-auth token, "ping" is answered with "pong",
+	// the account's item changes are sent as they happen
+	void ServeWebSocket(CHttpServer::socket_t sock, const std::atomic<bool>& stopping)
+	{
+		CMarketAccount* account = nullptr;
+
+		std::string buf;
+		char readBuf[4096];
+
+		while (!stopping)
+		{
+			if (account)
+			{
+				std::vector<std::string> messages;
+
+				{
+					std::lock_guard<std::mutex> lock(stateMutex);
+
+					// sales and purchases only happen when something looks
+					for (int market = 0; market < marketCount; ++market)
+						Update(account, market);
+
+					messages.swap(account->wsMessages);
+				}
+
+				bool sendOk = true;
+				for (const auto& message : messages)
+					sendOk = sendOk && SendWsFrame(sock, WsOpcode::TEXT, message);
+
+				if (!sendOk)
+					break;
+			}
+
+			if (!CHttpServer::WaitReadable(sock, 50))
+				continue;
+
+			const int readSz = recv(sock, readBuf, sizeof(readBuf), 0);
+			if (readSz <= 0)
+				break;
+
+			buf.append(readBuf, readSz);
+
+			int opcode;
+			std::string payload;
+			bool closed = false;
+
+			while (!closed && ParseWsFrame(&buf, &opcode, &payload))
+			{
+				if (opcode == (int)WsOpcode::CLOSE)
+				{
+					SendWsFrame(sock, WsOpcode::CLOSE, payload.substr(0, 2));
+					closed = true;
+				}
+				else if (opcode == (int)WsOpcode::PING)
+					closed = !SendWsFrame(sock, WsOpcode::PONG, payload);
+				else if (opcode != (int)WsOpcode::TEXT)
+					continue;
+				else if (account)
+				{
+					if (payload == "ping")
+						closed = !SendWsFrame(sock, WsOpcode::TEXT, "pong");
+				}
+				else if (!payload.compare(0, sizeof(wsTokenPrefix) - 1, wsTokenPrefix))
+				{
+					std::lock_guard<std::mutex> lock(stateMutex);
+
+					account = GetAccount(payload.substr(sizeof(wsTokenPrefix) - 1));
+					++account->wsSessionCount;
+				}
+				else
+					closed = true;
+			}
+
+			if (closed)
+				break;
+		}
+
+		if (account)
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+
+			if (!--account->wsSessionCount)
+				account->wsMessages.clear();
+		}
+	}
+
+	void HandleWebSocketUpgrade(const CHttpServer::CRequest& request, CHttpServer::CReply* reply)
+	{
+		const char* upgrade = request.GetHeader("Upgrade");
+		const char* key = request.GetHeader("Sec-WebSocket-Key");
+
+		if (!upgrade || _stricmp(upgrade, "websocket") || !key)
+		{
+			reply->status = 400;
+			return;
+		}
+
+		// base64 of the SHA-1 of the key and the protocol's GUID
+		const std::string acceptInput = std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+		byte hash[WC_SHA_DIGEST_SIZE];
+		byte accept[64];
+		word32 acceptSz = sizeof(accept) - 1;
+
+		if (wc_ShaHash((const byte*)acceptInput.data(), (word32)acceptInput.size(), hash) ||
+			Base64_Encode_NoNl(hash, sizeof(hash), accept, &acceptSz))
+		{
+			reply->status = 500;
+			return;
+		}
+
+		reply->status = 101;
+		reply->headers.emplace_back("Upgrade", "websocket");
+		reply->headers.emplace_back("Connection", "Upgrade");
+		reply->headers.emplace_back("Sec-WebSocket-Accept", std::string((const char*)accept, acceptSz));
+		reply->upgrade = ServeWebSocket;
+	}
+
+	void HandleRequest(const CHttpServer::CRequest& request, CHttpServer::CReply* reply)
+	{
+		const std::string path = request.GetPath();
+
+		if (!path.compare(0, sizeof("/mock/") - 1, "/mock/"))
+		{
+			HandleControl(request, reply, path);
+			return;
+		}
+
+		++stats.requests;
+
+		if (ApplyRule(request, reply))
+			return;
+
+		if (path == wsPath)
+		{
+			HandleWebSocketUpgrade(request, reply);
+			return;
+		}
+
+		const int market = GetMarket(path);
+		if (0 <= market)
+		{
+			const size_t methodStart = 1 + strlen(marketHosts[market]) + sizeof("/api/v2/") - 1;
+			HandleMarket(request, reply, market, path.substr(methodStart));
+			return;
+		}
+
+		const char steamCommunity[] = "/steamcommunity.com";
+		const char steamApi[] = "/api.steampowered.com";
+		const char steamLogin[] = "/login.steampowered.com";
+
+		if (!path.compare(0, sizeof(steamCommunity) - 1, steamCommunity))
+			HandleSteamCommunity(request, reply, path.substr(sizeof(steamCommunity) - 1));
+		else if (!path.compare(0, sizeof(steamApi) - 1, steamApi))
+			HandleSteamApi(request, reply, path.substr(sizeof(steamApi) - 1));
+		else if (!path.compare(0, sizeof(steamLogin) - 1, steamLogin))
+			HandleSteamLogin(request, reply, path.substr(sizeof(steamLogin) - 1));
+		else
+			reply->status = 404;
+	}
+
+	// one rule per line: <match> [delay=ms] [jitter=ms] [error=rate] [status=code] [429=rate] [retry-after=s]
+	// rates are shares of the matching requests from 0 to 1, # starts a comment
+	// e.g. "tradeoffer/new/send delay=300 jitter=200 error=0.05" or "* 429=0.01 retry-after=2"
+	bool LoadScript(const char* path)
+	{
+		Log(LogChannel::GENERAL, "Loading script %s...", path);
+
+		FILE* file = fopen(path, "rb");
+		if (!file)
+		{
+			putsnn("opening failed\n");
+			return false;
+		}
+
+		char line[1024];
+		int lineNumber = 0;
+
+		while (fgets(line, sizeof(line), file))
+		{
+			++lineNumber;
+
+			char* comment = strchr(line, '#');
+			if (comment)
+				*comment = '\0';
+
+			CRule rule;
+			bool valid = true;
+
+			for (char* token = strtok(line, " \t\r\n"); token; token = strtok(nullptr, " \t\r\n"))
+			{
+				if (rule.match.empty())
+				{
+					rule.match = token;
+					continue;
+				}
+
+				char* value = strchr(token, '=');
+				if (!value)
+				{
+					valid = false;
+					break;
+				}
+
+				*value++ = '\0';
+
+				if (!strcmp(token, "delay"))
+					rule.delayMs = atoi(value);
+				else if (!strcmp(token, "jitter"))
+					rule.jitterMs = atoi(value);
+				else if (!strcmp(token, "error"))
+					rule.errorRate = atof(value);
+				else if (!strcmp(token, "status"))
+					rule.errorStatus = atoi(value);
+				else if (!strcmp(token, "429"))
+					rule.throttleRate = atof(value);
+				else if (!strcmp(token, "retry-after"))
+					rule.retryAfter = atoi(value);
+				else
+				{
+					valid = false;
+					break;
+				}
+			}
+
+			if (!valid)
+			{
+				fclose(file);
+				LogAppend("invalid rule on line %d\n", lineNumber);
+				return false;
+			}
+
+			if (!rule.match.empty())
+				config.rules.emplace_back(std::move(rule));
+		}
+
+		fclose(file);
+
+		LogAppend("%zu rules\n", config.rules.size());
+		return true;
+	}
+}
@@ -0,0 +1,96 @@
+// local stand-in for the Market and Steam endpoints, run the client with --base-url http://127.0.0.1:<port>
+#include "Precompiled.h"
+#include <random>
+#include "RingBuffer.h"
+#include "Log.h"
+#include "Misc.h"
+#include "Clock.h"
+#include "Histogram.h"
+#include "HttpServer.h"
+#include "Mock.h"
+
+void PrintHelp()
+{
+	putsnn("Options:\n"
+		"--help\t\t\t\tPrint help\n"
+		"--port [port]\t\t\tPort to listen on, 8080 by default\n"
+		"--address [ip]\t\t\tAddress to listen on, 127.0.0.1 by default\n"
+		"--listings [count]\t\tItems listed per account and market, 10 by default\n"
+		"--sales-per-min [rate]\t\tAverage sales per account and market per minute, 0 by default\n"
+		"--purchases-per-min [rate]\tAverage purchases per account and market per minute, 0 by default\n"
+		"--accept-delay [seconds]\tAverage time buyers take to accept confirmed offers, 60 by default, 0 never accepts\n"
+		"--script [path]\t\t\tLatency, error and 429 rules, see Mock.h\n"
+		"--seed [seed]\t\t\tSeed of the sale and rule randomness\n"
+		"\n"
+		"GET /mock/stats returns counters, /mock/sell and /mock/buy?key=<market api key>&market=<index>[&count=<n>] "
+		"sell or buy items right away\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint16_t port = 8080;
+	const char* address = "127.0.0.1";
+	const char* script = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+
+		if (!strcmp(arg, "--help"))
+		{
+			PrintHelp();
+			return 0;
+		}
+		else if ((i < (argc - 1)) && !strcmp(arg, "--port"))
+			port = (uint16_t)atoi(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--address"))
+			address = argv[++i];
+		else if ((i < (argc - 1)) && !strcmp(arg, "--listings"))
+			Mock::config.listings = strtoull(argv[++i], nullptr, 10);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--sales-per-min"))
+			Mock::config.salesPerMin = atof(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--purchases-per-min"))
+			Mock::config.purchasesPerMin = atof(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--accept-delay"))
+			Mock::config.acceptDelaySec = atof(argv[++i]);
+		else if ((i < (argc - 1)) && !strcmp(arg, "--script"))
+			script = argv[++i];
+		else if ((i < (argc - 1)) && !strcmp(arg, "--seed"))
+			Mock::config.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else
+			Log(LogChannel::GENERAL, "Unknown argument: %s\n", arg);
+	}
+
+	Logger::CWriterContext logWriter;
+
+	SetExitSignalHandlers();
+
+	if (script && !Mock::LoadScript(script))
+		return 1;
+
+	CHttpServer server;
+
+	Log(LogChannel::GENERAL, "Listening on %s:%u...", address, (unsigned)port);
+
+	if (!server.Start(address, port, Mock::HandleRequest))
+	{
+		putsnn("fail\n");
+		return 1;
+	}
+
+	putsnn("ok\n");
+
+	while (SleepUnlessExiting(10s))
+	{
+		Log(LogChannel::GENERAL, "%llu requests, %llu sales, %llu items given, %llu taken, %llu expired\n",
+			(unsigned long long)Mock::stats.requests,
+			(unsigned long long)Mock::stats.sales,
+			(unsigned long long)Mock::stats.itemsGiven,
+			(unsigned long long)Mock::stats.itemsTaken,
+			(unsigned long long)Mock::stats.itemsExpired);
+	}
+
+	server.Stop();
+
+	return 0;
+}
@@ -24,6 +24,8 @@ class CAccount
 
 	char		name[PATH_MAX] = "";
 
+	Steam::Guard::CHmacSha1Key	identityKey;
+
 	class COffer
 	{
 	public:
@@ -43,10 +45,35 @@ class CAccount
 	std::vector<std::string>	givenOfferIds[(int)Market::Market::COUNT];
 	std::vector<std::string>	takenOfferIds[(int)Market::Market::COUNT];
 
+	Sla::CTracker				slaTracker;
+
+	// markets listed in the settings file are always polled and the rest never,
+	// without the file every market is polled and the ones without items are only probed every emptyMarketProbeInterval
+	bool						marketsConfigured = false;
+	bool						marketEnabled[(int)Market::Market::COUNT];
+	rapidjson::SizeType			itemCounts[(int)Market::Market::COUNT] = { 0 };	// as of the market's last poll
+
+	// see UpdatePollInterval
+	Clock::time_point			nextPollTime[(int)Market::Market::COUNT] = {};
+	Clock::duration				pollInterval[(int)Market::Market::COUNT] = {};
+
+	// session refresh, market ping and cancelling expired offers
+	Clock::time_point			nextHousekeepingTime = {};
+	bool						lastRunOk = true;
+
+	// --push, set on the first run
+	std::shared_ptr<Push::CSubscription>	pushSubscription;
 
 public:
 	static constexpr const char	directory[] = "accounts";
 	static constexpr const char	extension[] = ".bin";
+	static constexpr const char	settingsExtension[] = ".json";
+
+	static inline std::chrono::seconds	emptyMarketProbeInterval = 10min;
+	static inline std::chrono::seconds	pollIntervalMin = 15s;
+	static inline std::chrono::seconds	pollIntervalMax = 1min;
+	static inline std::chrono::seconds	housekeepingInterval = 1min;	// the market wants a ping at least every few minutes
+	static inline std::chrono::seconds	pushPollIntervalMax = 5min;		// while the push channel is connected
 
 private:
 	static constexpr int		scryptCost = 16;			// (128 * (2^16) * 8) = 64 MB RAM
@@ -120,6 +147,80 @@ private:
 		return true;
 	}
 
+	// accounts/<name>.json, optional: { "markets": [ "CSGO", "DOTA" ] }
+	bool LoadSettings()
+	{
+		std::fill(std::begin(marketEnabled), std::end(marketEnabled), true);
+		marketsConfigured = false;
+
+		char path[PATH_MAX];
+
+		char* pathEnd = path;
+		pathEnd = stpcpy(pathEnd, directory);
+		pathEnd = stpcpy(pathEnd, "/");
+		pathEnd = stpcpy(pathEnd, name);
+		strcpy(pathEnd, settingsExtension);
+
+		FILE* file = u8fopen(path, "rb");
+		if (!file)
+			return true;
+
+		fclose(file);
+
+		Log(LogChannel::GENERAL, "Reading settings...");
+
+		unsigned char* contents = nullptr;
+		long contentsSz = 0;
+		if (!ReadFile(path, &contents, &contentsSz))
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		rapidjson::Document parsed;
+		parsed.Parse((char*)contents, contentsSz);
+
+		free(contents);
+
+		if (parsed.HasParseError() || !parsed.IsObject())
+		{
+			putsnn("JSON parsing failed\n");
+			return false;
+		}
+
+		const auto iterMarkets = parsed.FindMember("markets");
+		if (iterMarkets != parsed.MemberEnd())
+		{
+			if (!iterMarkets->value.IsArray())
+			{
+				putsnn("markets isn't an array\n");
+				return false;
+			}
+
+			std::fill(std::begin(marketEnabled), std::end(marketEnabled), false);
+			marketsConfigured = true;
+
+			for (const auto& market : iterMarkets->value.GetArray())
+			{
+				int index = 0;
+				while (index < (int)Market::Market::COUNT &&
+					!(market.IsString() && !_stricmp(market.GetString(), Market::marketNames[index])))
+					++index;
+
+				if (index == (int)Market::Market::COUNT)
+				{
+					putsnn("unknown market, expected one of CSGO, DOTA, TF2, RUST, GIFTS\n");
+					return false;
+				}
+
+				marketEnabled[index] = true;
+			}
+		}
+
+		putsnn("ok\n");
+		return true;
+	}
+
 	bool Load(const char* path, const char* decryptPass)
 	{
 		Log(LogChannel::GENERAL, "Reading...");
@@ -234,8 +335,14 @@ private:
 					identitySecret, Steam::Guard::secretsSz + 1, Steam::Guard::secretsSz))
 				return false;
 
+			if (!identityKey.Init(identitySecret))
+			{
+				Log(LogChannel::GENERAL, "Invalid identity_secret\n");
+				continue;
+			}
+
 			rapidjson::Document doc;
-			if (Steam::Guard::FetchConfirmations(curl, steamId64, identitySecret, deviceId, &doc))
+			if (Steam::Guard::FetchConfirmations(curl, steamId64, &identityKey, deviceId, &doc))
 				break;
 		}
 		return true;
@@ -305,12 +412,40 @@ private:
 
 		free(jwtPayload);
 
-		const time_t curTime = time(nullptr);
+		const time_t curTime = Clock::GetUnixTime();
 
 		return (curTime >= exp);
 	}
 
 public:
+	const char* GetName() const
+	{
+		return name;
+	}
+
+	// synthetic accounts of the benchmarks, skips the account file, login and market setup
+	bool InitSynthetic(const char* accountName, const char* accountMarketApiKey, const char* accountSteamId64,
+		const char* accountIdentitySecret, const char* accountSteamApiKey)
+	{
+		if (sizeof(name) <= strlen(accountName) ||
+			sizeof(marketApiKey) <= strlen(accountMarketApiKey) ||
+			sizeof(steamId64) <= strlen(accountSteamId64) ||
+			sizeof(identitySecret) <= strlen(accountIdentitySecret) ||
+			sizeof(steamApiKey) <= strlen(accountSteamApiKey))
+			return false;
+
+		strcpy(name, accountName);
+		strcpy(marketApiKey, accountMarketApiKey);
+		strcpy(steamId64, accountSteamId64);
+		strcpy(identitySecret, accountIdentitySecret);
+		strcpy(steamApiKey, accountSteamApiKey);
+		strcpy(deviceId, "android:00000000-0000-0000-0000-000000000000");
+
+		std::fill(std::begin(marketEnabled), std::end(marketEnabled), true);
+
+		return identityKey.Init(identitySecret);
+	}
+
 	bool Init(CURL* curl, const char* sessionId, const char* encryptPass, 
 		const char* argName = nullptr, const char* path = nullptr, bool isMaFile = false)
 	{
@@ -383,12 +518,32 @@ public:
 
 				if (Steam::Auth::BeginAuthSessionViaCredentials(curl, username, password, steamId64, clientId, requestId))
 				{
+					Steam::Guard::CHmacSha1Key sharedKey;
+
+					if (sharedSecret[0] && !sharedKey.Init(sharedSecret))
+						Log(LogChannel::GENERAL, "Invalid shared_secret\n");
+
+					// code of the window we're going to try next, generated ahead so it's sent right as the window starts
+					char nextTwoFactorCode[Steam::Guard::twoFactorCodeBufSz] = "";
+					time_t nextTwoFactorCodeWindow = -1;
+
 					for (size_t i = 0; i < 3; ++i)
 					{
 						char twoFactorCode[Steam::Guard::twoFactorCodeBufSz] = "";
 
-						if (sharedSecret[0])
-							Steam::Guard::GenerateTwoFactorAuthCode(sharedSecret, twoFactorCode);
+						time_t twoFactorCodeWindow = -1;
+
+						if (sharedKey.IsInitialized())
+						{
+							twoFactorCodeWindow = std::max(nextTwoFactorCodeWindow, Steam::Guard::GetUsableTwoFactorCodeWindow());
+
+							if (twoFactorCodeWindow == nextTwoFactorCodeWindow)
+								strcpy(twoFactorCode, nextTwoFactorCode);
+							else
+								Steam::Guard::GenerateTwoFactorAuthCode(&sharedKey, twoFactorCodeWindow, twoFactorCode);
+
+							Steam::Guard::WaitForTwoFactorCodeWindow(twoFactorCodeWindow);
+						}
 
 						if (!twoFactorCode[0])
 						{
@@ -397,18 +552,43 @@ public:
 								break;
 						}
 
-						if (!Steam::Auth::UpdateAuthSessionWithSteamGuardCode(curl, steamId64, clientId, twoFactorCode))
+						const bool codeSent = Steam::Auth::UpdateAuthSessionWithSteamGuardCode(curl, steamId64, clientId, twoFactorCode);
+
+						// Steam never saw the code, so its window can be tried again as long as it's usable
+						if (!codeSent && 0 <= twoFactorCodeWindow)
+						{
+							nextTwoFactorCodeWindow = twoFactorCodeWindow;
+							strcpy(nextTwoFactorCode, twoFactorCode);
+						}
+
+						memset(twoFactorCode, 0, sizeof(twoFactorCode));
+
+						// a typed in code can't be retried without asking again
+						if (!codeSent && twoFactorCodeWindow < 0)
 							break;
 
-						if (Steam::Auth::PollAuthSessionStatus(curl, clientId, requestId, refreshToken, accessToken))
+						if (codeSent && Steam::Auth::PollAuthSessionStatus(curl, clientId, requestId, refreshToken, accessToken))
 						{
 							loggedIn = true;
 							break;
 						}
 
-						std::this_thread::sleep_for(5s);
+						if (twoFactorCodeWindow < 0)
+						{
+							Clock::SleepFor(5s);
+							continue;
+						}
+
+						if (!codeSent)
+							continue;
+
+						// the code of this window didn't work, the next window's is the earliest one that can
+						nextTwoFactorCodeWindow = twoFactorCodeWindow + 1;
+						Steam::Guard::GenerateTwoFactorAuthCode(&sharedKey, nextTwoFactorCodeWindow, nextTwoFactorCode);
 					}
 
+					memset(nextTwoFactorCode, 0, sizeof(nextTwoFactorCode));
+
 					if (loggedIn)
 					{
 						if (!Steam::SetRefreshCookie(curl, steamId64, refreshToken) ||
@@ -443,6 +623,12 @@ public:
 		if (!identitySecret[0] && !EnterIdentitySecret(curl))
 			return false;
 
+		if (!identityKey.IsInitialized() && !identityKey.Init(identitySecret))
+		{
+			Log(LogChannel::GENERAL, "Invalid identity_secret\n");
+			return false;
+		}
+
 		if (!marketApiKey[0] && !EnterMarketApiKey(curl))
 			return false;
 
@@ -457,6 +643,9 @@ public:
 
 		memset(refreshToken, 0, sizeof(refreshToken));
 
+		if (!LoadSettings())
+			return false;
+
 		if (!Steam::SetInventoryPublic(curl, sessionId, steamId64))
 			return false;
 
@@ -476,6 +665,9 @@ private:
 	// remove inactive and cancel expired
 	bool CancelExpiredSentOffers(CURL* curl, const char* sessionId)
 	{
+		Trace::CTraceSpan span("account", "CancelExpiredSentOffers");
+		RateLimiter::CPriorityScope priority(RateLimiter::Priority::CANCELLATION);
+
 		bool allEmpty = true;
 
 		for (const auto& marketSentOffers : sentOffers)
@@ -490,7 +682,7 @@ private:
 		if (allEmpty)
 			return true;
 
-		const time_t timestamp = time(nullptr);
+		const time_t timestamp = Clock::GetUnixTime();
 
 		rapidjson::Document docOffers;
 		// include inactive offers accepted within 5 mins ago so they are kept in sentOffers
@@ -523,8 +715,10 @@ private:
 
 		bool allOk = true;
 
-		for (auto& marketSentOffers : sentOffers)
+		for (int market = 0; market < (int)Market::Market::COUNT; ++market)
 		{
+			auto& marketSentOffers = sentOffers[market];
+
 			for (auto iterSentOffer = marketSentOffers.begin(); iterSentOffer != marketSentOffers.end(); )
 			{
 				bool erase = true;
@@ -550,6 +744,8 @@ private:
 							erase = false;
 							allOk = false;
 						}
+						else
+							Events::Emit(Events::EventType::CANCELLED, market, sentOfferId);
 					}
 					else
 						erase = false;
@@ -575,6 +771,8 @@ private:
 
 	int GetMarketStatus(CURL* curl, int market, rapidjson::Document* outDocItems)
 	{
+		RateLimiter::CPriorityScope priority(RateLimiter::Priority::POLLING);
+
 		if (!Market::GetItems(curl, marketApiKey, market, outDocItems))
 		{
 			Log(LogChannel::GENERAL, "[%s] Getting items status failed\n", Market::marketNames[market]);
@@ -586,6 +784,9 @@ private:
 
 		int marketStatus = 0;
 
+		// asset ids of sold and item ids of bought items still waiting for us
+		std::unordered_set<std::string> waitingKeys;
+
 		const rapidjson::Value& items = (*outDocItems)["items"];
 		const rapidjson::SizeType itemCount = (items.IsArray() ? items.Size() : 0);
 
@@ -605,6 +806,12 @@ private:
 
 				const char* itemId = item["item_id"].GetString();
 
+				const auto iterAssetId = item.FindMember("assetid");
+				const std::string assetId = 
+					(iterAssetId != item.MemberEnd()) ? Sla::GetIdString(iterAssetId->value) : std::string();
+
+				waitingKeys.insert(assetId);
+
 				bool given = false;
 
 				for (const auto& givenItemId : marketGivenItemIds)
@@ -622,6 +829,8 @@ private:
 
 					const char* itemName = item["market_hash_name"].GetString();
 					Log(LogChannel::GENERAL, "[%s] Sold \"%s\"\n", Market::marketNames[market], itemName);
+					Events::Emit(Events::EventType::SALE_DETECTED, market, itemId, itemName);
+					slaTracker.OnSaleDetected(market, assetId);
 				}
 
 				marketStatus |= (int)MarketStatus::SOLD;
@@ -635,6 +844,8 @@ private:
 
 				const char* itemId = item["item_id"].GetString();
 
+				waitingKeys.insert(itemId);
+
 				bool taken = false;
 
 				for (const auto& takenItemId : marketTakenItemIds)
@@ -652,12 +863,19 @@ private:
 
 					const char* itemName = item["market_hash_name"].GetString();
 					Log(LogChannel::GENERAL, "[%s] Bought \"%s\"\n", Market::marketNames[market], itemName);
+					Events::Emit(Events::EventType::PURCHASE_DETECTED, market, itemId, itemName);
+
+					const auto iterBotId = item.FindMember("botid");
+					slaTracker.OnPurchaseDetected(market, itemId,
+						(iterBotId != item.MemberEnd()) ? Sla::GetIdString(iterBotId->value) : std::string());
 				}
 
 				marketStatus |= (int)MarketStatus::BOUGHT;
 			}
 		}
 
+		slaTracker.Prune(market, waitingKeys);
+
 		if (!(marketStatus & (int)MarketStatus::SOLD))
 			marketGivenItemIds.clear();
 
@@ -669,6 +887,8 @@ private:
 
 	bool GiveItemBot(CURL* curl, const char* sessionId, int market)
 	{
+		RateLimiter::CPriorityScope priority(RateLimiter::Priority::DELIVERY);
+
 		char offerId[Steam::Trade::offerIdBufSz];
 		char partnerId64[UINT64_MAX_STR_SIZE];
 
@@ -684,9 +904,13 @@ private:
 		if (!Steam::Trade::Accept(curl, sessionId, offerId, partnerId64))
 			return false;
 
-		if (!Steam::Guard::AcceptConfirmation(curl, steamId64, identitySecret, deviceId, offerId))
+		Events::Emit(Events::EventType::OFFER_ACCEPTED, market, offerId);
+
+		if (!Steam::Guard::AcceptConfirmation(curl, steamId64, &identityKey, deviceId, offerId))
 			return false;
 
+		Events::Emit(Events::EventType::CONFIRMED, market, offerId);
+
 		givenOfferIds[market].emplace_back(offerId);
 
 		return true;
@@ -694,6 +918,9 @@ private:
 
 	bool GiveItemsP2P(CURL* curl, const char* sessionId, int market)
 	{
+		Trace::CTraceSpan span("account", "GiveItemsP2P");
+		RateLimiter::CPriorityScope priority(RateLimiter::Priority::DELIVERY);
+
 		rapidjson::Document docGiveDetails;
 
 		if (!Market::RequestGiveP2PAll(curl, marketApiKey, market, &docGiveDetails))
@@ -750,12 +977,18 @@ private:
 				continue;
 			}
 
-			if (!Steam::Guard::AcceptConfirmation(curl, steamId64, identitySecret, deviceId, sentOfferId))
+			Events::Emit(Events::EventType::OFFER_SENT, market, sentOfferId);
+			slaTracker.OnOfferSent(name, market, offer["items"], sentOfferId);
+
+			if (!Steam::Guard::AcceptConfirmation(curl, steamId64, &identityKey, deviceId, sentOfferId))
 			{
 				allOk = false;
 				continue;
 			}
 
+			Events::Emit(Events::EventType::CONFIRMED, market, sentOfferId);
+			slaTracker.OnOfferConfirmed(name, market, sentOfferId);
+
 			sentOffers[market].emplace_back(offerHash, sentOfferId);
 
 			if (!Market::TradeReady(curl, marketApiKey, market, sentOfferId))
@@ -763,6 +996,9 @@ private:
 				allOk = false;
 				continue;
 			}
+
+			Events::Emit(Events::EventType::TRADE_READY, market, sentOfferId);
+			slaTracker.OnTradeReady(name, market, sentOfferId);
 		}
 
 		return allOk;
@@ -788,6 +1024,9 @@ private:
 		if (!Steam::Trade::Accept(curl, sessionId, offerId, partnerId64.c_str()))
 			return false;
 
+		Events::Emit(Events::EventType::OFFER_ACCEPTED, market, offerId);
+		slaTracker.OnBotOfferAccepted(name, market, partnerId32);
+
 		takenOfferIds[market].emplace_back(offerId);
 
 		return true;
@@ -795,6 +1034,9 @@ private:
 
 	bool TakeItems(CURL* curl, const char* sessionId, int market, rapidjson::Document* docItems)
 	{
+		Trace::CTraceSpan span("account", "TakeItems");
+		RateLimiter::CPriorityScope priority(RateLimiter::Priority::DELIVERY);
+
 		const rapidjson::Value& items = (*docItems)["items"];
 		if (!items.IsArray())
 			return true;
@@ -829,26 +1071,108 @@ private:
 		return allOk;
 	}
 
+	// a market with something going on is polled again after pollIntervalMin, a quiet one backs off exponentially
+	// up to pollIntervalMax, or pushPollIntervalMax while pushes arrive, one without any items waits for the next probe
+	// unless it's configured
+	void UpdatePollInterval(int market, int marketStatus, rapidjson::SizeType prevItemCount, Clock::time_point curTime)
+	{
+		Clock::duration& interval = pollInterval[market];
+
+		const Clock::duration intervalMax = (pushSubscription && pushSubscription->connected) ?
+			std::max(pushPollIntervalMax, pollIntervalMax) : pollIntervalMax;
+
+		if (!marketsConfigured && !itemCounts[market])
+			interval = emptyMarketProbeInterval;
+		else if (marketStatus || itemCounts[market] != prevItemCount)
+			interval = pollIntervalMin;
+		else
+			interval = std::min<Clock::duration>(std::max<Clock::duration>(interval * 2, pollIntervalMin), intervalMax);
+
+		nextPollTime[market] = curTime + interval;
+	}
+
+	// a failing market (bad key, outage) is retried after pollIntervalMin, then backs off up to pollIntervalMax,
+	// so it doesn't spend the request budget every other account shares
+	void BackOffPollInterval(int market, Clock::time_point curTime)
+	{
+		Clock::duration& interval = pollInterval[market];
+
+		interval = std::min<Clock::duration>(std::max<Clock::duration>(interval * 2, pollIntervalMin), pollIntervalMax);
+		nextPollTime[market] = curTime + interval;
+	}
+
+	bool StartSteamSession(CURL* curl, char* outAccessToken)
+	{
+		if (!Steam::Auth::RefreshJWTSession(curl, outAccessToken))
+		{
+			Log(LogChannel::GENERAL, "Steam session refresh failed\n");
+			return false;
+		}
+
+		if (!Steam::SetLoginCookie(curl, steamId64, outAccessToken))
+		{
+			Log(LogChannel::GENERAL, "Setting Steam login cookie failed\n");
+			return false;
+		}
+
+		return true;
+	}
+
 	void PrintListings(const rapidjson::SizeType* itemCounts)
 	{
 		Log(LogChannel::GENERAL, "Listings: ");
 
 		for (int i = 0; i < (int)Market::Market::COUNT; ++i)
 		{
-			printf("%s: %u", Market::marketNames[i], itemCounts[i]);
+			LogAppend("%s: %u", Market::marketNames[i], itemCounts[i]);
 
 			if (i < ((int)Market::Market::COUNT - 1))
 				putsnn(" | ");
 		}
 
-		putchar('\n');
+		putsnn("\n");
+
+		Metrics::SetListings(name, itemCounts);
 	}
 
 public:
+	// when RunMarkets has something to do next
+	Clock::time_point GetNextRunTime() const
+	{
+		// the market pushed something, poll right away
+		if (pushSubscription && pushSubscription->IsPending())
+			return Clock::time_point();
+
+		Clock::time_point nextRunTime = nextHousekeepingTime;
+
+		for (int market = 0; market < (int)Market::Market::COUNT; ++market)
+		{
+			if (marketEnabled[market])
+				nextRunTime = std::min(nextRunTime, nextPollTime[market]);
+		}
+
+		return nextRunTime;
+	}
+
+	bool IsLastRunOk() const
+	{
+		return lastRunOk;
+	}
+
 	bool RunMarkets(CURL* curl, const char* sessionId, const char* proxy)
+	{
+		lastRunOk = RunDueMarkets(curl, sessionId, proxy);
+		return lastRunOk;
+	}
+
+private:
+	// housekeeping and the markets whose poll is due
+	bool RunDueMarkets(CURL* curl, const char* sessionId, const char* proxy)
 	{
 		CLoggingContext loggingContext(name);
 
+		Trace::CTraceSpan span("account", "RunMarkets");
+
 		// commented out because oauth seems to be gone
 		//const int refreshRes = Steam::Auth::RefreshOAuthSession(curl, oauthToken, loginToken);
 		//if (refreshRes < 0)
@@ -863,53 +1187,81 @@ public:
 		//	return false;
 		//}
 
+		bool allOk = true;
+
+		// the market polls in between only need the market API key
 		char accessToken[Steam::Auth::jwtBufSz];
+		bool steamSessionStarted = false;
 
-		if (!Steam::Auth::RefreshJWTSession(curl, accessToken))
-		{
-			Log(LogChannel::GENERAL, "Steam session refresh failed\n");
-			return false;
-		}
+		const bool housekeepingDue = (nextHousekeepingTime <= Clock::Now());
 
-		if (!Steam::SetLoginCookie(curl, steamId64, accessToken))
+		if (housekeepingDue)
 		{
-			Log(LogChannel::GENERAL, "Setting Steam login cookie failed\n");
-			return false;
-		}
+			nextHousekeepingTime = Clock::Now() + housekeepingInterval;
 
-		bool allOk = true;
+			if (!StartSteamSession(curl, accessToken))
+				return false;
 
-		if (!Market::PingNew(curl, marketApiKey, accessToken, proxy))
-			allOk = false;
+			steamSessionStarted = true;
+		}
 
-		memset(accessToken, 0, sizeof(accessToken));
+		if (Push::IsEnabled() && !pushSubscription)
+			pushSubscription = Push::Subscribe(name, marketApiKey);
 
-		if (!CancelExpiredSentOffers(curl, sessionId))
+		// the notifications don't reliably name the market, poll them all
+		if (pushSubscription && pushSubscription->TakePending())
 		{
-			allOk = false;
-			Log(LogChannel::GENERAL, "Cancelling some of the expired sent offers failed, "
-				"manually cancel the sent offers older than 15 mins if the error persists\n");
+			for (int marketIter = 0; marketIter < (int)Market::Market::COUNT; ++marketIter)
+				nextPollTime[marketIter] = Clock::time_point();
 		}
 
-		rapidjson::SizeType itemCounts[(int)Market::Market::COUNT] = { 0 };
+		bool anyPolled = false;
 
 		for (int marketIter = 0; marketIter < (int)Market::Market::COUNT; ++marketIter)
 		{
+			if (!marketEnabled[marketIter])
+				continue;
+
+			const auto curTime = Clock::Now();
+
+			if (curTime < nextPollTime[marketIter])
+				continue;
+
+			anyPolled = true;
+
+			Trace::CTraceSpan marketSpan("market", "%s", Market::marketNames[marketIter]);
+
 			rapidjson::Document docItems;
 			const int marketStatus = GetMarketStatus(curl, marketIter, &docItems);
 			
 			if (marketStatus < 0)
 			{
+				BackOffPollInterval(marketIter, curTime);
 				allOk = false;
 				continue;
 			}
 
+			const rapidjson::SizeType prevItemCount = itemCounts[marketIter];
+
 			const rapidjson::Value& items = docItems["items"];
 			itemCounts[marketIter] = (items.IsArray() ? items.Size() : 0);
 
+			UpdatePollInterval(marketIter, marketStatus, prevItemCount, curTime);
+
 			if (!marketStatus)
 				continue;
 
+			if (!steamSessionStarted)
+			{
+				if (!StartSteamSession(curl, accessToken))
+				{
+					allOk = false;
+					continue;
+				}
+
+				steamSessionStarted = true;
+			}
+
 #ifdef _WIN32
 			FlashCurrentWindow();
 #endif // _WIN32
@@ -943,7 +1295,25 @@ public:
 				takenOfferIds[marketIter].clear();
 		}
 
-		PrintListings(itemCounts);
+		// after the deliveries so they don't wait for it
+		if (housekeepingDue)
+		{
+			if (!Market::PingNew(curl, marketApiKey, accessToken, proxy))
+				allOk = false;
+
+			if (!CancelExpiredSentOffers(curl, sessionId))
+			{
+				allOk = false;
+				Log(LogChannel::GENERAL, "Cancelling some of the expired sent offers failed, "
+					"manually cancel the sent offers older than 15 mins if the error persists\n");
+			}
+		}
+
+		if (steamSessionStarted)
+			memset(accessToken, 0, sizeof(accessToken));
+
+		if (anyPolled)
+			PrintListings(itemCounts);
 
 		return allOk;
 	}
@@ -0,0 +1,202 @@
+#pragma once
+
+// per host on top of the service's rate limiter:
+// 429 and 5xx responses halve the host's request rate and every success adds a little back (AIMD), Retry-After is
+// honoured, and a host that keeps failing gets no requests until a single probe gets through (circuit breaker),
+// so an outage costs a failed request per account instead of a timeout per request
+namespace Backoff
+{
+	enum class CircuitState
+	{
+		CLOSED,		// requests go through
+		OPEN,		// requests fail right away until openUntil
+		HALF_OPEN	// one probe request goes through, the others fail right away
+	};
+
+	const int failureThreshold = 5;			// consecutive failures that open the circuit
+	const auto openDurationMin = 15s;		// doubles every time a probe fails
+	const auto openDurationMax = 5min;
+	const auto retryAfterMax = 5min;
+
+	const double rateMin = 1.0 / 30;		// requests per second
+	const double rateIncrease = 0.05;		// per successful request
+	const double rateUnthrottledMin = 10;	// used instead of the service's rate when it's faster than this
+
+	class CHost
+	{
+	public:
+		// 0 while unthrottled, then requests per second
+		double					rate = 0;
+		Clock::time_point		nextRequestTime;	// from the rate and Retry-After
+
+		CircuitState			circuitState = CircuitState::CLOSED;
+		int						failureCount = 0;	// consecutive
+		Clock::duration			openDuration = openDurationMin;
+		Clock::time_point		openUntil;
+		bool					probing = false;
+
+		CShardedCounter			throttledCount;
+		CShardedCounter			skippedCount;
+	};
+
+	std::mutex									mutex;
+	std::unordered_map<std::string, CHost>		hosts;
+
+	CHost* GetHost(const std::string& name)
+	{
+		return &hosts[name];
+	}
+
+	// the rate requests go at while unthrottled, where halving starts from
+	double GetUnthrottledRate(std::chrono::microseconds serviceInterval)
+	{
+		const double intervalSec = std::chrono::duration<double>(serviceInterval).count();
+		return (intervalSec < (1 / rateUnthrottledMin)) ? rateUnthrottledMin : (1 / intervalSec);
+	}
+
+	// sleeps while the host is throttled, false if the request shouldn't be sent because the host is down,
+	// outWait is how long it slept
+	bool BeforeRequest(const std::string& name, std::chrono::microseconds* outWait)
+	{
+		*outWait = 0us;
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		CHost* host = GetHost(name);
+		const auto curTime = Clock::Now();
+
+		if (host->circuitState == CircuitState::OPEN)
+		{
+			if (curTime < host->openUntil)
+			{
+				host->skippedCount.Add();
+				return false;
+			}
+
+			host->circuitState = CircuitState::HALF_OPEN;
+		}
+
+		if (host->circuitState == CircuitState::HALF_OPEN)
+		{
+			if (host->probing)
+			{
+				host->skippedCount.Add();
+				return false;
+			}
+
+			host->probing = true;
+		}
+
+		const auto requestTime = std::max(curTime, host->nextRequestTime);
+
+		if (host->rate)
+		{
+			host->nextRequestTime = requestTime + std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(1 / host->rate));
+		}
+
+		lock.unlock();
+
+		if (curTime < requestTime)
+		{
+			Trace::CTraceSpan span("ratelimit", "%s backoff", name.c_str());
+			Clock::SleepUntil(requestTime);
+
+			*outWait = std::chrono::duration_cast<std::chrono::microseconds>(requestTime - curTime);
+		}
+
+		return true;
+	}
+
+	// the host answered, but not in a way that says it's down
+	bool IsHostUp(long httpCode, CURLcode respCode)
+	{
+		if (respCode == CURLE_OK)
+			return true;
+
+		if (respCode == CURLE_HTTP_RETURNED_ERROR)
+			return (httpCode < 500);
+
+		// the request itself was bad
+		return (respCode == CURLE_URL_MALFORMAT || respCode == CURLE_UNSUPPORTED_PROTOCOL ||
+			respCode == CURLE_TOO_MANY_REDIRECTS || respCode == CURLE_WRITE_ERROR || respCode == CURLE_ABORTED_BY_CALLBACK);
+	}
+
+	void AfterRequest(const std::string& name, CURL* curl, CURLcode respCode, std::chrono::microseconds serviceInterval)
+	{
+		long httpCode = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+
+		curl_off_t retryAfterSec = 0;
+#if LIBCURL_VERSION_NUM >= CURL_VERSION_BITS(7, 66, 0)
+		curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retryAfterSec);
+#endif // LIBCURL_VERSION_NUM >= 7.66.0
+
+		const bool throttled = (respCode == CURLE_HTTP_RETURNED_ERROR && (httpCode == 429 || 500 <= httpCode));
+		const bool hostUp = IsHostUp(httpCode, respCode);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		CHost* host = GetHost(name);
+		const auto curTime = Clock::Now();
+
+		if (throttled)
+		{
+			host->throttledCount.Add();
+			host->rate = std::max(rateMin, (host->rate ? host->rate : GetUnthrottledRate(serviceInterval)) / 2);
+		}
+		else if (host->rate && respCode == CURLE_OK)
+		{
+			host->rate += rateIncrease;
+
+			if (GetUnthrottledRate(serviceInterval) <= host->rate)
+				host->rate = 0;
+		}
+
+		if (0 < retryAfterSec)
+		{
+			const auto retryTime = curTime + std::min<Clock::duration>(std::chrono::seconds(retryAfterSec), retryAfterMax);
+			host->nextRequestTime = std::max(host->nextRequestTime, retryTime);
+		}
+
+		const bool probe = host->probing;
+		host->probing = false;
+
+		if (hostUp)
+		{
+			host->failureCount = 0;
+
+			if (host->circuitState != CircuitState::CLOSED)
+			{
+				host->circuitState = CircuitState::CLOSED;
+				host->openDuration = openDurationMin;
+				Log(LogChannel::LIBCURL, "%s is back up, resuming requests\n", name.c_str());
+			}
+
+			return;
+		}
+
+		++host->failureCount;
+
+		if (probe || (host->circuitState == CircuitState::CLOSED && failureThreshold <= host->failureCount))
+		{
+			if (probe)
+				host->openDuration = std::min<Clock::duration>(host->openDuration * 2, openDurationMax);
+
+			host->circuitState = CircuitState::OPEN;
+			host->openUntil = curTime + host->openDuration;
+
+			Log(LogChannel::LIBCURL, "%s seems to be down, pausing its requests for %lld s\n", name.c_str(),
+				(long long)std::chrono::duration_cast<std::chrono::seconds>(host->openDuration).count());
+		}
+	}
+
+	template <typename Func>
+	void ForEachHost(Func func)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (const auto& entry : hosts)
+			func(entry.first, entry.second);
+	}
+}
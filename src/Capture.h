@@ -0,0 +1,509 @@
+#pragma once
+
+// --record writes every Market and Steam request and its response to a gzipped capture file,
+// --replay serves them back in order from a local server through the base URL override, without network access
+namespace Capture
+{
+	// the gzipped file starts with this, followed by records:
+	// i64 start in microseconds since recording started, u32 duration in microseconds, i32 curl code, i32 HTTP status,
+	// then method, URL without the scheme, request headers, request body, response headers and response body
+	// each as u32 length + bytes, numbers are little endian
+	const char magic[] = "OMCCAP1\n";
+
+	// sanity limit of a single field when reading
+	const uint32_t maxFieldSz = 64 * 1024 * 1024;
+
+	// a request and its response, a request that follows redirects has one per hop
+	class CExchange
+	{
+	public:
+		int64_t			startUs = 0;
+		uint32_t		durationUs = 0;
+		int32_t			curlCode = CURLE_OK;
+		int32_t			status = 0;		// 0 if there was no response
+		std::string		method;
+		std::string		url;			// host, path and query
+		std::string		requestHeaders;
+		std::string		requestBody;
+		std::string		responseHeaders;
+		std::string		responseBody;
+	};
+
+	std::atomic<bool>		recording(false);
+	gzFile					file = nullptr;
+	std::mutex				fileMutex;
+
+	std::chrono::steady_clock::time_point	startTime;
+
+	// the request in flight on this thread, the time drift thread has its own
+	thread_local std::vector<CExchange>		pending;
+	thread_local std::chrono::steady_clock::time_point	requestStartTime;
+
+	inline int64_t GetTimeUs(std::chrono::steady_clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(time - startTime).count();
+	}
+
+	void FinishExchange(CExchange* exchange, std::chrono::steady_clock::time_point endTime)
+	{
+		exchange->durationUs = (uint32_t)std::max<int64_t>(0, GetTimeUs(endTime) - exchange->startUs);
+	}
+
+	// the cookies are the account's session, the replay doesn't need them
+	std::string RedactCookies(const std::string& headers)
+	{
+		std::string out;
+		size_t lineStart = 0;
+
+		while (lineStart < headers.size())
+		{
+			size_t lineEnd = headers.find('\n', lineStart);
+			lineEnd = (lineEnd == std::string::npos) ? headers.size() : (lineEnd + 1);
+
+			if (!_strnicmp(headers.c_str() + lineStart, "Cookie:", 7))
+				out += "Cookie: redacted\r\n";
+			else
+				out.append(headers, lineStart, lineEnd - lineStart);
+
+			lineStart = lineEnd;
+		}
+
+		return out;
+	}
+
+	int DebugCallback(CURL* curl, curl_infotype type, char* data, size_t size, void* userData)
+	{
+		if (!recording)
+			return 0;
+
+		if (type == CURLINFO_HEADER_OUT)
+		{
+			// a new hop unless it's the rest of the headers of the current one
+			if (pending.empty() || pending.back().status)
+			{
+				const auto curTime = std::chrono::steady_clock::now();
+
+				if (!pending.empty())
+					FinishExchange(&pending.back(), curTime);
+
+				pending.emplace_back();
+
+				CExchange& exchange = pending.back();
+				exchange.startUs = GetTimeUs((pending.size() == 1) ? requestStartTime : curTime);
+				exchange.method.assign(data, std::find(data, data + size, ' '));
+
+				const char* url = nullptr;
+				curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+				if (url)
+					exchange.url = Curl::GetHostAndPath(url);
+			}
+
+			pending.back().requestHeaders.append(data, size);
+		}
+		else if (type == CURLINFO_DATA_OUT && !pending.empty())
+			pending.back().requestBody.append(data, size);
+		else if (type == CURLINFO_HEADER_IN && !pending.empty())
+		{
+			CExchange& exchange = pending.back();
+
+			// a status line, 100 Continue is followed by the real one
+			if (size > 5 && !strncmp(data, "HTTP/", 5))
+			{
+				const char* status = (const char*)memchr(data, ' ', size);
+				exchange.status = status ? atoi(status + 1) : 0;
+				exchange.responseHeaders.clear();
+			}
+			else if (!(size <= 2 && (data[0] == '\r' || data[0] == '\n')))
+				exchange.responseHeaders.append(data, size);
+		}
+
+		return 0;
+	}
+
+	// response bodies as the write callback gets them, the debug callback's are still chunked
+	void OnData(const void* data, size_t size)
+	{
+		if (!recording || pending.empty())
+			return;
+
+		pending.back().responseBody.append((const char*)data, size);
+	}
+
+	template <typename T>
+	void WriteLittleEndian(T value)
+	{
+		unsigned char buf[sizeof(T)];
+
+		for (size_t i = 0; i < sizeof(T); ++i)
+			buf[i] = (unsigned char)((uint64_t)value >> (i * 8));
+
+		gzwrite(file, buf, sizeof(buf));
+	}
+
+	void WriteString(const std::string& str)
+	{
+		WriteLittleEndian((uint32_t)str.size());
+
+		if (!str.empty())
+			gzwrite(file, str.data(), (unsigned)str.size());
+	}
+
+	void WriteExchange(const CExchange& exchange)
+	{
+		WriteLittleEndian(exchange.startUs);
+		WriteLittleEndian(exchange.durationUs);
+		WriteLittleEndian(exchange.curlCode);
+		WriteLittleEndian(exchange.status);
+		WriteString(exchange.method);
+		WriteString(exchange.url);
+		WriteString(RedactCookies(exchange.requestHeaders));
+		WriteString(exchange.requestBody);
+		WriteString(exchange.responseHeaders);
+		WriteString(exchange.responseBody);
+	}
+
+	// Market and Steam curl_easy_perform call these around every request
+	void BeginRequest()
+	{
+		if (!recording)
+			return;
+
+		pending.clear();
+		requestStartTime = std::chrono::steady_clock::now();
+	}
+
+	void EndRequest(CURL* curl, CURLcode respCode)
+	{
+		if (!recording)
+			return;
+
+		const auto curTime = std::chrono::steady_clock::now();
+
+		// failed before anything was sent, e.g. resolving or connecting
+		if (pending.empty())
+		{
+			pending.emplace_back();
+
+			CExchange& exchange = pending.back();
+			exchange.startUs = GetTimeUs(requestStartTime);
+
+			const char* method = nullptr;
+			curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_METHOD, &method);
+			exchange.method = method ? method : "GET";
+
+			const char* url = nullptr;
+			curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+			if (url)
+				exchange.url = Curl::GetHostAndPath(url);
+		}
+
+		FinishExchange(&pending.back(), curTime);
+		pending.back().curlCode = respCode;
+
+		std::lock_guard<std::mutex> lock(fileMutex);
+
+		if (file)
+		{
+			for (const CExchange& exchange : pending)
+				WriteExchange(exchange);
+		}
+
+		pending.clear();
+	}
+
+	// call before the handle is duplicated so the copies record too
+	bool StartRecording(CURL* curl, const char* path)
+	{
+		Log(LogChannel::LIBCURL, "Recording requests to %s...", path);
+
+		file = gzopen(path, "wb6");
+		if (!file)
+		{
+			putsnn("opening failed\n");
+			return false;
+		}
+
+		gzwrite(file, magic, sizeof(magic) - 1);
+
+		// the debug callback only gets called in verbose mode, and gets all of its output instead of stderr
+		if (curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, DebugCallback) != CURLE_OK ||
+			curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L) != CURLE_OK)
+		{
+			gzclose(file);
+			file = nullptr;
+			putsnn("fail\n");
+			return false;
+		}
+
+		Curl::CResponse::onData = OnData;
+
+		startTime = std::chrono::steady_clock::now();
+		recording = true;
+
+		putsnn("ok\n");
+		return true;
+	}
+
+	void StopRecording()
+	{
+		recording = false;
+
+		std::lock_guard<std::mutex> lock(fileMutex);
+
+		if (file)
+		{
+			gzclose(file);
+			file = nullptr;
+		}
+	}
+
+	class CRecordingContext
+	{
+	public:
+		CRecordingContext() {
+
+		}
+		~CRecordingContext() {
+			StopRecording();
+		}
+	};
+
+	// responses of every method and URL without the query, served in recorded order,
+	// the last one repeats once they run out so polling past the end of the capture still gets answers
+	class CReplayQueue
+	{
+	public:
+		std::vector<CExchange>	exchanges;
+		size_t					next = 0;
+	};
+
+	std::unordered_map<std::string, CReplayQueue>	replayQueues;
+	std::mutex										replayMutex;
+	bool											replayTiming = false;
+	std::atomic<uint64_t>							replayMissCount(0);
+
+	std::string GetReplayKey(const std::string& method, const std::string& url)
+	{
+		return method + ' ' + url.substr(0, url.find('?'));
+	}
+
+	template <typename T>
+	bool ReadLittleEndian(gzFile src, T* out)
+	{
+		unsigned char buf[sizeof(T)];
+		if (gzread(src, buf, sizeof(buf)) != (int)sizeof(buf))
+			return false;
+
+		uint64_t value = 0;
+		for (size_t i = 0; i < sizeof(T); ++i)
+			value |= (uint64_t)buf[i] << (i * 8);
+
+		*out = (T)value;
+		return true;
+	}
+
+	bool ReadString(gzFile src, std::string* out)
+	{
+		uint32_t size;
+		if (!ReadLittleEndian(src, &size) || maxFieldSz < size)
+			return false;
+
+		out->resize(size);
+		return (!size || gzread(src, &(*out)[0], size) == (int)size);
+	}
+
+	bool ReadExchange(gzFile src, CExchange* out)
+	{
+		return ReadLittleEndian(src, &out->startUs) &&
+			ReadLittleEndian(src, &out->durationUs) &&
+			ReadLittleEndian(src, &out->curlCode) &&
+			ReadLittleEndian(src, &out->status) &&
+			ReadString(src, &out->method) &&
+			ReadString(src, &out->url) &&
+			ReadString(src, &out->requestHeaders) &&
+			ReadString(src, &out->requestBody) &&
+			ReadString(src, &out->responseHeaders) &&
+			ReadString(src, &out->responseBody);
+	}
+
+	bool LoadCapture(const char* path, size_t* outCount)
+	{
+		gzFile src = gzopen(path, "rb");
+		if (!src)
+			return false;
+
+		char fileMagic[sizeof(magic) - 1];
+		if (gzread(src, fileMagic, sizeof(fileMagic)) != (int)sizeof(fileMagic) || memcmp(fileMagic, magic, sizeof(fileMagic)))
+		{
+			gzclose(src);
+			return false;
+		}
+
+		size_t count = 0;
+
+		// a capture cut short by a crash keeps the records before the last one
+		CExchange exchange;
+		while (ReadExchange(src, &exchange))
+		{
+			replayQueues[GetReplayKey(exchange.method, exchange.url)].exchanges.push_back(std::move(exchange));
+			exchange = CExchange();
+			++count;
+		}
+
+		gzclose(src);
+
+		*outCount = count;
+		return true;
+	}
+
+	// a recorded absolute URL points back at the replay server
+	std::string RewriteLocation(const std::string& location)
+	{
+		if (location.compare(0, 7, "http://") && location.compare(0, 8, "https://"))
+			return location;
+
+		return Curl::baseUrl + '/' + Curl::GetHostAndPath(location.c_str());
+	}
+
+	// scopes a recorded cookie like Curl::GetCookieScope does, to the host's path on the replay server over plain http
+	std::string RewriteSetCookie(const std::string& cookie, const std::string& host)
+	{
+		std::string out;
+		std::string domain = host;
+		std::string path = "/";
+
+		size_t attrStart = 0;
+		while (attrStart < cookie.size())
+		{
+			size_t attrEnd = cookie.find(';', attrStart);
+			if (attrEnd == std::string::npos)
+				attrEnd = cookie.size();
+
+			const size_t nameStart = cookie.find_first_not_of(' ', attrStart);
+			const std::string attr = (nameStart < attrEnd) ? cookie.substr(nameStart, attrEnd - nameStart) : std::string();
+
+			if (!_strnicmp(attr.c_str(), "Domain=", 7))
+			{
+				domain = attr.substr(7);
+				if (!domain.empty() && domain[0] == '.')
+					domain.erase(0, 1);
+			}
+			else if (!_strnicmp(attr.c_str(), "Path=", 5))
+				path = attr.substr(5);
+			else if (!attr.empty() && _stricmp(attr.c_str(), "Secure"))
+			{
+				if (!out.empty())
+					out += "; ";
+
+				out += attr;
+			}
+
+			attrStart = attrEnd + 1;
+		}
+
+		return out + "; Path=/" + domain + path;
+	}
+
+	void HandleReplay(const CHttpServer::CRequest& request, CHttpServer::CReply* reply)
+	{
+		// the target is /host/path?query
+		const std::string key = GetReplayKey(request.method, request.target.substr(1));
+
+		CExchange exchange;
+		{
+			std::lock_guard<std::mutex> lock(replayMutex);
+
+			auto iter = replayQueues.find(key);
+			if (iter == replayQueues.end())
+			{
+				++replayMissCount;
+				Log(LogChannel::LIBCURL, "Replay has no response to %s\n", key.c_str());
+
+				reply->status = 404;
+				return;
+			}
+
+			CReplayQueue& queue = iter->second;
+			exchange = queue.exchanges[std::min(queue.next, queue.exchanges.size() - 1)];
+			++queue.next;
+		}
+
+		if (replayTiming)
+			std::this_thread::sleep_for(std::chrono::microseconds(exchange.durationUs));
+
+		// no response was recorded, e.g. a timeout, closing the connection fails the request too
+		if (!exchange.status)
+		{
+			reply->status = 0;
+			return;
+		}
+
+		const std::string host = exchange.url.substr(0, exchange.url.find('/'));
+
+		reply->status = exchange.status;
+		reply->body = std::move(exchange.responseBody);
+
+		const std::string& headers = exchange.responseHeaders;
+		size_t lineStart = 0;
+
+		while (lineStart < headers.size())
+		{
+			size_t lineEnd = headers.find("\r\n", lineStart);
+			if (lineEnd == std::string::npos)
+				lineEnd = headers.size();
+
+			const size_t colon = headers.find(':', lineStart);
+			if (colon < lineEnd)
+			{
+				const std::string name = headers.substr(lineStart, colon - lineStart);
+				const size_t valueStart = headers.find_first_not_of(" \t", colon + 1);
+				const std::string value = (valueStart < lineEnd) ? headers.substr(valueStart, lineEnd - valueStart) : std::string();
+
+				// the server frames the reply itself
+				if (!_stricmp(name.c_str(), "Content-Type"))
+					reply->contentType = value;
+				else if (!_stricmp(name.c_str(), "Location"))
+					reply->headers.emplace_back(name, RewriteLocation(value));
+				else if (!_stricmp(name.c_str(), "Set-Cookie"))
+					reply->headers.emplace_back(name, RewriteSetCookie(value, host));
+				else if (_stricmp(name.c_str(), "Content-Length") && _stricmp(name.c_str(), "Transfer-Encoding") &&
+					_stricmp(name.c_str(), "Connection") && _stricmp(name.c_str(), "Keep-Alive"))
+				{
+					reply->headers.emplace_back(name, value);
+				}
+			}
+
+			lineStart = lineEnd + 2;
+		}
+	}
+
+	// loads the capture and points every request at a local server answering from it
+	bool StartReplay(CHttpServer* server, const char* path, bool timing)
+	{
+		Log(LogChannel::LIBCURL, "Loading capture %s...", path);
+
+		size_t count;
+		if (!LoadCapture(path, &count))
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		LogAppend("%zu requests\n", count);
+
+		replayTiming = timing;
+
+		Log(LogChannel::LIBCURL, "Starting replay server...");
+
+		if (!server->Start("127.0.0.1", 0, HandleReplay))
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		putsnn("ok\n");
+
+		const std::string baseUrl = "http://127.0.0.1:" + std::to_string(server->GetPort());
+		return Curl::SetBaseUrl(baseUrl.c_str());
+	}
+}
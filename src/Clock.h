@@ -0,0 +1,75 @@
+#pragma once
+
+// time as the scheduling logic sees it: rate limits, tick spacing, offer TTLs, Steam time and trade timings
+// the simulation switches it to virtual time, which starts at a given unix time and only moves when something sleeps,
+// so hours of ticks run as fast as the requests do. latency statistics and traces keep measuring real time
+namespace Clock
+{
+	typedef std::chrono::steady_clock::time_point time_point;
+	typedef std::chrono::steady_clock::duration duration;
+
+	std::atomic<bool>	isVirtual(false);
+
+	std::mutex			virtualMutex;
+	time_point			virtualNow;
+	time_point			virtualStart;
+	int64_t				virtualStartUnixTimeMs = 0;
+
+	// call before anything else reads the clock, there's no going back
+	void StartVirtual(int64_t unixTimeMs)
+	{
+		std::lock_guard<std::mutex> lock(virtualMutex);
+
+		virtualStart = std::chrono::steady_clock::now();
+		virtualNow = virtualStart;
+		virtualStartUnixTimeMs = unixTimeMs;
+		isVirtual = true;
+	}
+
+	inline time_point Now()
+	{
+		if (!isVirtual)
+			return std::chrono::steady_clock::now();
+
+		std::lock_guard<std::mutex> lock(virtualMutex);
+		return virtualNow;
+	}
+
+	inline int64_t GetUnixTimeMs()
+	{
+		if (!isVirtual)
+		{
+			return std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+
+		std::lock_guard<std::mutex> lock(virtualMutex);
+		return virtualStartUnixTimeMs + std::chrono::duration_cast<std::chrono::milliseconds>(virtualNow - virtualStart).count();
+	}
+
+	inline time_t GetUnixTime()
+	{
+		return (time_t)(GetUnixTimeMs() / 1000);
+	}
+
+	// virtual time jumps ahead instead, time never goes back when sleepers overlap
+	void SleepUntil(time_point time)
+	{
+		if (!isVirtual)
+		{
+			std::this_thread::sleep_until(time);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(virtualMutex);
+
+		if (virtualNow < time)
+			virtualNow = time;
+	}
+
+	template <typename Rep, typename Period>
+	void SleepFor(std::chrono::duration<Rep, Period> duration)
+	{
+		SleepUntil(Now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+	}
+}
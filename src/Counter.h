@@ -0,0 +1,51 @@
+#pragma once
+
+// counter split into cache line sized shards, each thread adds to its own shard
+// so worker threads never contend, readers sum the shards
+class CShardedCounter
+{
+public:
+	static const size_t shardCount = 16;
+
+private:
+	class alignas(64) CShard
+	{
+	public:
+		std::atomic<uint64_t> value;
+	};
+
+	CShard shards[shardCount];
+
+	static size_t GetShardIndex()
+	{
+		static std::atomic<size_t> nextShardIndex(0);
+		thread_local const size_t shardIndex = (nextShardIndex++ % shardCount);
+
+		return shardIndex;
+	}
+
+public:
+	CShardedCounter()
+	{
+		for (auto& shard : shards)
+			shard.value.store(0, std::memory_order_relaxed);
+	}
+
+	CShardedCounter(const CShardedCounter&) = delete;
+	CShardedCounter(const CShardedCounter&&) = delete;
+
+	void Add(uint64_t value = 1)
+	{
+		shards[GetShardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	uint64_t Get() const
+	{
+		uint64_t sum = 0;
+
+		for (const auto& shard : shards)
+			sum += shard.value.load(std::memory_order_relaxed);
+
+		return sum;
+	}
+};
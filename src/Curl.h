@@ -28,9 +28,21 @@ namespace Curl
 			size = 0;
 		}
 
+		// --record tees response bodies through this
+		static void (*onData)(const void* data, size_t size);
+
+		// the response the request in flight on this thread writes to, so a retry can drop what a failed attempt received
+		static thread_local CResponse* writing;
+
 		static size_t WriteCallback(void* data, size_t size, size_t count, CResponse* out)
 		{
 			const size_t totalSize = count * size;
+
+			writing = out;
+
+			if (onData)
+				onData(data, totalSize);
+
 			char* newMem = (char*)realloc(out->data, out->size + totalSize + 1);
 			if (!newMem)
 			{
@@ -49,16 +61,260 @@ namespace Curl
 		}
 	};
 
+	void (*CResponse::onData)(const void* data, size_t size) = nullptr;
+	thread_local CResponse* CResponse::writing = nullptr;
+
+	class CTimeoutPolicy
+	{
+	public:
+		const char*	pathSuffix;		// of the URL's host and path, nullptr for the default
+		long		connectTimeoutMs;
+		long		timeoutMs;
+		long		lowSpeedLimit;		// bytes per second, the request is aborted after lowSpeedTime below it
+		long		lowSpeedTime;		// seconds
+		int			attempts;			// more than 1 only for requests that are safe to repeat
+	};
+
+	// the first one with a matching suffix applies, small requests give up sooner so a stalled one doesn't hold
+	// up the rest of the tick, reads are retried right away since a fresh connection usually gets through
+	const CTimeoutPolicy timeoutPolicies[] =
+	{
+		{ "/api/v2/ping-new",							3000, 8000, 100, 5, 1 },
+		{ "/api/v2/get-ws-auth",						3000, 8000, 100, 5, 2 },
+		{ "/api/v2/test",								3000, 8000, 100, 5, 2 },
+		{ "/api/v2/items",								3000, 10000, 500, 5, 2 },
+		{ "/IEconService/GetTradeOffers/v1/",			3000, 15000, 1000, 5, 2 },
+		{ "/mobileconf/getlist",						3000, 10000, 500, 5, 2 },
+		{ "/ITwoFactorService/QueryTime/v1/",			3000, 5000, 100, 3, 2 },
+	};
+
+	const CTimeoutPolicy defaultTimeoutPolicy = { nullptr, 5000, 20000, 100, 10, 1 };
+
+	// of the URL this thread set last
+	thread_local const CTimeoutPolicy* requestPolicy = &defaultTimeoutPolicy;
+
+	const CTimeoutPolicy* GetTimeoutPolicy(const char* hostAndPath)
+	{
+		const size_t pathLen = strcspn(hostAndPath, "?#");
+
+		for (const auto& policy : timeoutPolicies)
+		{
+			const size_t suffixLen = strlen(policy.pathSuffix);
+
+			if (suffixLen <= pathLen && !strncmp(hostAndPath + pathLen - suffixLen, policy.pathSuffix, suffixLen))
+				return &policy;
+		}
+
+		return &defaultTimeoutPolicy;
+	}
+
+	void SetTimeoutPolicy(CURL* curl, const CTimeoutPolicy* policy)
+	{
+		requestPolicy = policy;
+
+		curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, policy->connectTimeoutMs);
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, policy->timeoutMs);
+		curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, policy->lowSpeedLimit);
+		curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, policy->lowSpeedTime);
+	}
+
+	// the request never got a complete response, so repeating it can't have a different effect than the first try
+	bool IsRetryable(CURLcode respCode)
+	{
+		return (respCode == CURLE_OPERATION_TIMEDOUT || respCode == CURLE_COULDNT_CONNECT ||
+			respCode == CURLE_GOT_NOTHING || respCode == CURLE_SEND_ERROR || respCode == CURLE_RECV_ERROR ||
+			respCode == CURLE_PARTIAL_FILE || respCode == CURLE_SSL_CONNECT_ERROR);
+	}
+
+	// set when the last request of this thread wasn't sent because its host is down, see Backoff.h
+	thread_local bool requestSkipped = false;
+
 	void PrintError(CURL* curl, CURLcode respCode)
 	{
-		if (respCode == CURLE_HTTP_RETURNED_ERROR)
+		if (requestSkipped)
+			LogAppend("skipped, the host is down\n");
+		else if (respCode == CURLE_HTTP_RETURNED_ERROR)
 		{
 			long httpCode;
 			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-			printf("request failed (HTTP response code %ld)\n", httpCode);
+			LogAppend("request failed (HTTP response code %ld)\n", httpCode);
 		}
 		else
-			printf("request failed (libcurl code %d)\n", respCode);
+			LogAppend("request failed (libcurl code %d)\n", respCode);
+	}
+
+	// --base-url sends every request to a local server instead, e.g. the mock server,
+	// https://steamcommunity.com/mobileconf/getlist becomes http://127.0.0.1:8080/steamcommunity.com/mobileconf/getlist
+	std::string baseUrl;
+	std::string baseUrlHost;	// host of the base URL without the port, cookies are scoped to it
+	std::string baseUrlPath;	// path of the base URL, without the trailing slash
+
+	bool SetBaseUrl(const char* url)
+	{
+		Log(LogChannel::LIBCURL, "Setting base URL override...");
+
+		const char* scheme = strstr(url, "://");
+		if (!scheme || !(!strncmp(url, "http://", 7) || !strncmp(url, "https://", 8)))
+		{
+			putsnn("fail, expected http://host[:port][/path]\n");
+			return false;
+		}
+
+		baseUrl = url;
+		while (!baseUrl.empty() && baseUrl.back() == '/')
+			baseUrl.pop_back();
+
+		const char* host = scheme + sizeof("://") - 1;
+		const char* hostEnd = host + strcspn(host, ":/");
+		const char* path = host + strcspn(host, "/");
+
+		baseUrlHost.assign(host, hostEnd);
+		baseUrlPath = path;
+		while (!baseUrlPath.empty() && baseUrlPath.back() == '/')
+			baseUrlPath.pop_back();
+
+		putsnn("ok\n");
+		return true;
+	}
+
+	// the URL without the scheme, and without the override server's address when it's a --base-url one,
+	// so requests to the override server are labelled and recorded like the real ones
+	const char* GetHostAndPath(const char* url)
+	{
+		const char* scheme = strstr(url, "://");
+		if (scheme)
+			url = scheme + sizeof("://") - 1;
+
+		if (!baseUrl.empty())
+		{
+			const char* baseHost = strstr(baseUrl.c_str(), "://") + sizeof("://") - 1;
+			const size_t baseHostLen = strlen(baseHost);
+
+			if (!strncmp(url, baseHost, baseHostLen) && url[baseHostLen] == '/')
+				url += baseHostLen + 1;
+		}
+
+		return url;
+	}
+
+	// host of the URL this thread set last, without the --base-url server's address
+	thread_local std::string requestHost;
+
+	// every request URL goes through here so --base-url can redirect it
+	CURLcode SetUrl(CURL* curl, const char* url)
+	{
+		const char* host = GetHostAndPath(url);
+		requestHost.assign(host, strcspn(host, ":/?#"));
+
+		SetTimeoutPolicy(curl, GetTimeoutPolicy(host));
+
+		if (baseUrl.empty())
+			return curl_easy_setopt(curl, CURLOPT_URL, url);
+
+		// already rewritten, e.g. a redirect from the override server
+		if (!strncmp(url, baseUrl.c_str(), baseUrl.size()) && url[baseUrl.size()] == '/')
+			return curl_easy_setopt(curl, CURLOPT_URL, url);
+
+		const char* scheme = strstr(url, "://");
+		const char* hostAndPath = scheme ? (scheme + sizeof("://") - 1) : url;
+
+		// libcurl copies the string
+		const std::string rewritten = baseUrl + '/' + hostAndPath;
+		return curl_easy_setopt(curl, CURLOPT_URL, rewritten.c_str());
+	}
+
+	// websocket URLs are redirected the same way, to the override server's ws:// or wss:// address
+	CURLcode SetWebSocketUrl(CURL* curl, const char* url)
+	{
+		if (baseUrl.empty())
+			return curl_easy_setopt(curl, CURLOPT_URL, url);
+
+		const char* scheme = strstr(url, "://");
+		const char* hostAndPath = scheme ? (scheme + sizeof("://") - 1) : url;
+
+		// http:// becomes ws://, https:// becomes wss://
+		const std::string rewritten = "ws" + baseUrl.substr(sizeof("http") - 1) + '/' + hostAndPath;
+		return curl_easy_setopt(curl, CURLOPT_URL, rewritten.c_str());
+	}
+
+	// with --base-url a cookie of a host is scoped to the host's path on the override server,
+	// so cookies of different hosts don't mix and are sent over plain http
+	void GetCookieScope(const char* domain, std::string* outDomain, std::string* outPath, bool* outSecure)
+	{
+		if (baseUrl.empty())
+		{
+			*outDomain = domain;
+			*outPath = "/";
+			*outSecure = true;
+			return;
+		}
+
+		const char httpOnlyPrefix[] = "#HttpOnly_";
+		const bool httpOnly = !strncmp(domain, httpOnlyPrefix, sizeof(httpOnlyPrefix) - 1);
+		if (httpOnly)
+			domain += sizeof(httpOnlyPrefix) - 1;
+
+		*outDomain = httpOnly ? (httpOnlyPrefix + baseUrlHost) : baseUrlHost;
+		*outPath = baseUrlPath + '/' + domain + '/';
+		*outSecure = !strncmp(baseUrl.c_str(), "https://", 8);
+	}
+
+	const size_t endpointLabelBufSz = 128;
+
+	// host and path of the last request without the scheme and query, numeric path segments become :id
+	// so requests about different offers or profiles share one label, e.g. steamcommunity.com/tradeoffer/:id/accept
+	void GetEndpointLabel(CURL* curl, char* out)
+	{
+		const char* url = nullptr;
+		curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+
+		if (!url)
+		{
+			strcpy(out, "unknown");
+			return;
+		}
+
+		url = GetHostAndPath(url);
+
+		char* outEnd = out;
+		const char* const outLast = out + endpointLabelBufSz - 1;
+
+		while (*url && *url != '?' && *url != '#' && outEnd < outLast)
+		{
+			const char* segmentEnd = url;
+			while (*segmentEnd && *segmentEnd != '/' && *segmentEnd != '?' && *segmentEnd != '#')
+				++segmentEnd;
+
+			bool numeric = (segmentEnd != url);
+			for (const char* iter = url; iter < segmentEnd; ++iter)
+			{
+				if (*iter < '0' || '9' < *iter)
+				{
+					numeric = false;
+					break;
+				}
+			}
+
+			if (numeric)
+			{
+				url = segmentEnd;
+
+				for (const char* iter = ":id"; *iter && outEnd < outLast; ++iter)
+					*outEnd++ = *iter;
+			}
+			else
+			{
+				while (url < segmentEnd && outEnd < outLast)
+					*outEnd++ = *url++;
+
+				url = segmentEnd;
+			}
+
+			if (*url == '/' && outEnd < outLast)
+				*outEnd++ = *url++;
+		}
+
+		*outEnd = '\0';
 	}
 
 	bool DownloadCACert(CURL* curl, const char* path)
@@ -143,7 +399,7 @@ namespace Curl
 			return nullptr;
 		}
 
-		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 20L);
+		SetTimeoutPolicy(curl, &defaultTimeoutPolicy);
 		curl_easy_setopt(curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
 		curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
 		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
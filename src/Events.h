@@ -0,0 +1,512 @@
+#pragma once
+
+namespace Market
+{
+	// defined in Market.h, which needs the events itself
+	extern const char* marketNames[];
+}
+
+// optional structured event sink for analytics, enabled with --events
+// events are queued without blocking and written by a background thread
+// as newline delimited JSON or a compact binary format to size rotated files,
+// rotated files are gzipped by another background thread
+namespace Events
+{
+	enum class EventType : uint8_t
+	{
+		SALE_DETECTED,
+		PURCHASE_DETECTED,
+		OFFER_SENT,
+		OFFER_ACCEPTED,
+		CONFIRMED,
+		TRADE_READY,
+		CANCELLED,
+		REQUEST_FAILED,
+
+		COUNT
+	};
+
+	const char* eventTypeNames[] =
+	{
+		"sale_detected",
+		"purchase_detected",
+		"offer_sent",
+		"offer_accepted",
+		"confirmed",
+		"trade_ready",
+		"cancelled",
+		"request_failed",
+	};
+
+	enum class Format
+	{
+		NDJSON,
+		BINARY
+	};
+
+	// binary files start with this, followed by records:
+	// u8 type, i8 market, i16 curl code, i32 http code, i64 unix time in ms,
+	// then account, id and text each as u8 length + bytes, numbers are little endian
+	const char binaryMagic[] = "OMCEVT1\n";
+
+	const size_t accountBufSz = 64;
+	const size_t idBufSz = 32;
+	const size_t textBufSz = 128;
+
+	const size_t eventCount = 4096;
+
+	// counts are kept even without --events for the metrics endpoint, index 0 is for events without a market
+	const size_t maxMarketCount = 8;
+	CShardedCounter emittedCounts[(size_t)EventType::COUNT][maxMarketCount + 1];
+
+	class CEvent
+	{
+	public:
+		int64_t		timestampMs;
+		EventType	type;
+		int8_t		market;		// -1 if not market specific
+		int16_t		curlCode;
+		int32_t		httpCode;
+		char		account[accountBufSz];
+		char		id[idBufSz];		// item id or trade offer id
+		char		text[textBufSz];	// item name, or endpoint label of a failed request
+	};
+
+	CRingBuffer<CEvent, eventCount>		events;
+
+	std::atomic<bool>					enabled(false);
+	std::atomic<size_t>					droppedCount(0);
+
+	Format								format = Format::NDJSON;
+	const char*							path = nullptr;
+	uint64_t							maxFileSz = 0;
+
+	FILE*								file = nullptr;
+	uint64_t							fileSz = 0;
+	bool								writeFailed = false;
+
+	// after a write failed, e.g. the disk is full, events are dropped until the file reopens
+	const auto							reopenInterval = 1min;
+	std::chrono::steady_clock::time_point	nextReopenTime;
+
+	std::thread							writerThread;
+	std::atomic<bool>					writerStopping(false);
+	std::mutex							writerMutex;
+	std::condition_variable				writerCondVar;
+
+	// rotated files waiting to be compressed
+	std::thread							compressorThread;
+	bool								compressorStopping = false;
+	std::vector<std::string>			compressQueue;
+	std::mutex							compressMutex;
+	std::condition_variable				compressCondVar;
+
+	inline void CopyTruncated(char* out, size_t outSz, const char* in)
+	{
+		if (!in)
+		{
+			out[0] = '\0';
+			return;
+		}
+
+		const size_t len = std::min(strlen(in), outSz - 1);
+		memcpy(out, in, len);
+		out[len] = '\0';
+	}
+
+	// market is -1 if the event isn't market specific
+	void Emit(EventType type, int market, const char* id = nullptr, const char* text = nullptr)
+	{
+		emittedCounts[(size_t)type][market + 1].Add();
+
+		if (!enabled)
+			return;
+
+		size_t pos;
+		CEvent* event = events.BeginPush(&pos);
+		if (!event)
+		{
+			++droppedCount;
+			return;
+		}
+
+		event->timestampMs = Clock::GetUnixTimeMs();
+		event->type = type;
+		event->market = (int8_t)market;
+		event->curlCode = 0;
+		event->httpCode = 0;
+		CopyTruncated(event->account, sizeof(event->account), g_pszLogAccountName);
+		CopyTruncated(event->id, sizeof(event->id), id);
+		CopyTruncated(event->text, sizeof(event->text), text);
+
+		events.EndPush(pos);
+	}
+
+	// endpoint from Curl::GetEndpointLabel
+	void EmitRequestFailed(CURL* curl, const char* endpoint, CURLcode respCode, int market = -1)
+	{
+		emittedCounts[(size_t)EventType::REQUEST_FAILED][market + 1].Add();
+
+		if (!enabled)
+			return;
+
+		size_t pos;
+		CEvent* event = events.BeginPush(&pos);
+		if (!event)
+		{
+			++droppedCount;
+			return;
+		}
+
+		long httpCode = 0;
+		if (respCode == CURLE_HTTP_RETURNED_ERROR)
+			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+
+		event->timestampMs = Clock::GetUnixTimeMs();
+		event->type = EventType::REQUEST_FAILED;
+		event->market = (int8_t)market;
+		event->curlCode = (int16_t)respCode;
+		event->httpCode = (int32_t)httpCode;
+		CopyTruncated(event->account, sizeof(event->account), g_pszLogAccountName);
+		event->id[0] = '\0';
+		CopyTruncated(event->text, sizeof(event->text), endpoint);
+
+		events.EndPush(pos);
+	}
+
+	void AddWritten(int written)
+	{
+		if (written < 0)
+			writeFailed = true;
+		else
+			fileSz += written;
+	}
+
+	void WriteJson(const CEvent* event)
+	{
+		AddWritten(fprintf(file, "{\"ts\":%lld,\"type\":\"%s\"",
+			(long long)event->timestampMs, eventTypeNames[(size_t)event->type]));
+
+		if (event->account[0])
+		{
+			AddWritten(fprintf(file, ",\"account\":"));
+			fileSz += WriteJsonString(file, event->account);
+		}
+
+		if (0 <= event->market)
+			AddWritten(fprintf(file, ",\"market\":\"%s\"", Market::marketNames[event->market]));
+
+		if (event->type == EventType::REQUEST_FAILED)
+		{
+			AddWritten(fprintf(file, ",\"endpoint\":"));
+			fileSz += WriteJsonString(file, event->text);
+			AddWritten(fprintf(file, ",\"curl_code\":%d,\"http_code\":%d", (int)event->curlCode, (int)event->httpCode));
+		}
+		else
+		{
+			if (event->id[0])
+			{
+				AddWritten(fprintf(file, ",\"id\":"));
+				fileSz += WriteJsonString(file, event->id);
+			}
+
+			if (event->text[0])
+			{
+				AddWritten(fprintf(file, ",\"item\":"));
+				fileSz += WriteJsonString(file, event->text);
+			}
+		}
+
+		fputs("}\n", file);
+		fileSz += 2;
+	}
+
+	template <typename T>
+	void WriteLittleEndian(T value)
+	{
+		unsigned char buf[sizeof(T)];
+
+		for (size_t i = 0; i < sizeof(T); ++i)
+			buf[i] = (unsigned char)((uint64_t)value >> (i * 8));
+
+		fwrite(buf, sizeof(buf), 1, file);
+		fileSz += sizeof(buf);
+	}
+
+	void WriteBinaryString(const char* str)
+	{
+		// buffers are smaller than 256 bytes
+		const uint8_t len = (uint8_t)strlen(str);
+
+		fputc(len, file);
+		fwrite(str, sizeof(char), len, file);
+		fileSz += 1 + len;
+	}
+
+	void WriteBinary(const CEvent* event)
+	{
+		WriteLittleEndian((uint8_t)event->type);
+		WriteLittleEndian(event->market);
+		WriteLittleEndian(event->curlCode);
+		WriteLittleEndian(event->httpCode);
+		WriteLittleEndian(event->timestampMs);
+		WriteBinaryString(event->account);
+		WriteBinaryString(event->id);
+		WriteBinaryString(event->text);
+	}
+
+	bool OpenFile()
+	{
+		file = fopen(path, "ab");
+		if (!file)
+			return false;
+
+		fseek(file, 0, SEEK_END);
+		fileSz = ftell(file);
+
+		if (!fileSz && format == Format::BINARY)
+		{
+			fwrite(binaryMagic, sizeof(char), sizeof(binaryMagic) - 1, file);
+			fileSz = sizeof(binaryMagic) - 1;
+		}
+
+		return true;
+	}
+
+	// renames the current file to path.YYYYmmdd-HHMMSS and queues it for compression
+	void Rotate()
+	{
+		fclose(file);
+		file = nullptr;
+
+		const time_t timestamp = time(nullptr);
+		tm localTime;
+#ifdef _WIN32
+		localtime_s(&localTime, &timestamp);
+#else
+		localtime_r(&timestamp, &localTime);
+#endif // _WIN32
+
+		char suffix[32];
+		strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &localTime);
+
+		std::string rotatedPath = std::string(path) + suffix;
+
+		std::error_code err;
+		for (int i = 1; std::filesystem::exists(rotatedPath, err) || std::filesystem::exists(rotatedPath + ".gz", err); ++i)
+			rotatedPath = std::string(path) + suffix + '-' + std::to_string(i);
+
+		if (rename(path, rotatedPath.c_str()))
+			Log(LogChannel::GENERAL, "Rotating event log %s failed\n", path);
+		else
+		{
+			std::lock_guard<std::mutex> lock(compressMutex);
+			compressQueue.emplace_back(std::move(rotatedPath));
+			compressCondVar.notify_one();
+		}
+
+		if (!OpenFile())
+		{
+			Log(LogChannel::GENERAL, "Reopening event log %s failed, events will be dropped\n", path);
+			nextReopenTime = std::chrono::steady_clock::now() + reopenInterval;
+		}
+	}
+
+	void CloseAfterWriteError()
+	{
+		Log(LogChannel::GENERAL, "Writing event log %s failed, events will be dropped until it reopens\n", path);
+
+		fclose(file);
+		file = nullptr;
+		writeFailed = false;
+		nextReopenTime = std::chrono::steady_clock::now() + reopenInterval;
+	}
+
+	bool Compress(const char* srcPath)
+	{
+		FILE* src = fopen(srcPath, "rb");
+		if (!src)
+			return false;
+
+		const std::string dstPath = std::string(srcPath) + ".gz";
+
+		gzFile dst = gzopen(dstPath.c_str(), "wb6");
+		if (!dst)
+		{
+			fclose(src);
+			return false;
+		}
+
+		bool ok = true;
+
+		char buf[64 * 1024];
+		size_t readSz;
+		while ((readSz = fread(buf, sizeof(char), sizeof(buf), src)))
+		{
+			if (gzwrite(dst, buf, (unsigned)readSz) != (int)readSz)
+			{
+				ok = false;
+				break;
+			}
+		}
+
+		if (ferror(src))
+			ok = false;
+
+		fclose(src);
+
+		if (gzclose(dst) != Z_OK)
+			ok = false;
+
+		if (!ok)
+		{
+			remove(dstPath.c_str());
+			return false;
+		}
+
+		remove(srcPath);
+		return true;
+	}
+
+	void CompressorMain()
+	{
+		std::unique_lock<std::mutex> lock(compressMutex);
+
+		while (true)
+		{
+			compressCondVar.wait(lock, [] { return compressorStopping || !compressQueue.empty(); });
+
+			if (compressQueue.empty())
+				break;
+
+			const std::string rotatedPath = std::move(compressQueue.front());
+			compressQueue.erase(compressQueue.begin());
+
+			lock.unlock();
+
+			// the uncompressed file is kept if compression fails
+			if (!Compress(rotatedPath.c_str()))
+				Log(LogChannel::GENERAL, "Compressing event log %s failed\n", rotatedPath.c_str());
+
+			lock.lock();
+		}
+	}
+
+	void WriterMain()
+	{
+		while (true)
+		{
+			bool wrote = false;
+
+			if (!file && nextReopenTime <= std::chrono::steady_clock::now())
+			{
+				if (OpenFile())
+					Log(LogChannel::GENERAL, "Event log %s reopened\n", path);
+				else
+					nextReopenTime = std::chrono::steady_clock::now() + reopenInterval;
+			}
+
+			CEvent* event;
+			while ((event = events.Peek()))
+			{
+				if (file)
+				{
+					if (format == Format::BINARY)
+						WriteBinary(event);
+					else
+						WriteJson(event);
+
+					wrote = true;
+
+					if (writeFailed || ferror(file))
+						CloseAfterWriteError();
+					else if (maxFileSz && maxFileSz <= fileSz)
+						Rotate();
+				}
+
+				events.Pop();
+			}
+
+			if (wrote && file && (fflush(file) || ferror(file)))
+				CloseAfterWriteError();
+
+			const size_t dropped = droppedCount.exchange(0);
+			if (dropped)
+				Log(LogChannel::GENERAL, "%zu events dropped, the event buffer was full\n", dropped);
+
+			if (writerStopping && events.IsEmpty())
+				break;
+
+			// events aren't latency sensitive, poll instead of waking the writer for every event
+			std::unique_lock<std::mutex> lock(writerMutex);
+			if (!writerStopping)
+				writerCondVar.wait_for(lock, 200ms);
+		}
+	}
+
+	// maxSz of 0 disables rotation
+	bool Start(const char* eventsPath, Format eventsFormat, uint64_t maxSz)
+	{
+		Log(LogChannel::GENERAL, "Opening event log %s...", eventsPath);
+
+		path = eventsPath;
+		format = eventsFormat;
+		maxFileSz = maxSz;
+
+		if (!OpenFile())
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		writerStopping = false;
+		compressorStopping = false;
+		writerThread = std::thread(WriterMain);
+		compressorThread = std::thread(CompressorMain);
+		enabled = true;
+
+		putsnn("ok\n");
+		return true;
+	}
+
+	// writes out queued events and waits for pending compressions
+	void Stop()
+	{
+		if (!enabled)
+			return;
+
+		enabled = false;
+
+		{
+			std::lock_guard<std::mutex> lock(writerMutex);
+			writerStopping = true;
+		}
+		writerCondVar.notify_one();
+		writerThread.join();
+
+		if (file)
+		{
+			fclose(file);
+			file = nullptr;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(compressMutex);
+			compressorStopping = true;
+		}
+		compressCondVar.notify_one();
+		compressorThread.join();
+	}
+
+	// stops the sink when leaving main
+	class CSinkContext
+	{
+	public:
+		CSinkContext() {
+
+		}
+		~CSinkContext() {
+			Stop();
+		}
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+// lock-free log-linear histogram in the spirit of HdrHistogram:
+// values below subBucketCount are exact, above that every power of two is split into subBucketCount buckets,
+// so a recorded value is off by at most 1/subBucketCount (~6%)
+// recording is a few relaxed atomic increments, reading while recording gives a slightly inconsistent snapshot
+class CHistogram
+{
+public:
+	static const int subBucketBits = 4;
+	static const uint64_t subBucketCount = (1 << subBucketBits);
+	// values up to 2^maxValueBits - 1, larger ones are clamped
+	static const int maxValueBits = 36;
+	static const size_t bucketCount = subBucketCount + (maxValueBits - subBucketBits) * subBucketCount;
+
+private:
+	std::atomic<uint64_t>	buckets[bucketCount];
+	std::atomic<uint64_t>	count;
+	std::atomic<uint64_t>	sum;
+	std::atomic<uint64_t>	max;
+
+	static size_t GetBucketIndex(uint64_t value)
+	{
+		if (value < subBucketCount)
+			return (size_t)value;
+
+		const uint64_t maxValue = ((uint64_t)1 << maxValueBits) - 1;
+		if (maxValue < value)
+			value = maxValue;
+
+		int exponent = 63;
+		while (!(value >> exponent))
+			--exponent;
+
+		const int shift = exponent - subBucketBits;
+		const uint64_t subBucket = (value >> shift) & (subBucketCount - 1);
+
+		return (size_t)(subBucketCount + shift * subBucketCount + subBucket);
+	}
+
+	// highest value that falls into the bucket
+	static uint64_t GetBucketMaxValue(size_t index)
+	{
+		if (index < subBucketCount)
+			return index;
+
+		const int shift = (int)((index - subBucketCount) / subBucketCount);
+		const uint64_t subBucket = (index - subBucketCount) % subBucketCount;
+
+		return (((subBucketCount + subBucket + 1) << shift) - 1);
+	}
+
+public:
+	CHistogram()
+	{
+		Reset();
+	}
+
+	CHistogram(const CHistogram&) = delete;
+	CHistogram(const CHistogram&&) = delete;
+
+	void Record(uint64_t value)
+	{
+		buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t curMax = max.load(std::memory_order_relaxed);
+		while (curMax < value && !max.compare_exchange_weak(curMax, value, std::memory_order_relaxed));
+	}
+
+	void Reset()
+	{
+		for (auto& bucket : buckets)
+			bucket.store(0, std::memory_order_relaxed);
+
+		count.store(0, std::memory_order_relaxed);
+		sum.store(0, std::memory_order_relaxed);
+		max.store(0, std::memory_order_relaxed);
+	}
+
+	uint64_t GetCount() const
+	{
+		return count.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetSum() const
+	{
+		return sum.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetMax() const
+	{
+		return max.load(std::memory_order_relaxed);
+	}
+
+	// upper bound of the bucket the quantile (0.0-1.0) falls into, never above the recorded max
+	uint64_t GetQuantile(double quantile) const
+	{
+		uint64_t total = 0;
+		for (const auto& bucket : buckets)
+			total += bucket.load(std::memory_order_relaxed);
+
+		if (!total)
+			return 0;
+
+		uint64_t rank = (uint64_t)(quantile * total + 0.5);
+		if (rank < 1)
+			rank = 1;
+
+		uint64_t seen = 0;
+
+		for (size_t i = 0; i < bucketCount; ++i)
+		{
+			seen += buckets[i].load(std::memory_order_relaxed);
+
+			if (rank <= seen)
+				return std::min(GetBucketMaxValue(i), GetMax());
+		}
+
+		return GetMax();
+	}
+
+	// calls callback(bucketMaxValue, cumulativeCount) for every non-empty bucket in ascending order
+	template <typename F>
+	void ForEachBucket(F callback) const
+	{
+		uint64_t cumulative = 0;
+
+		for (size_t i = 0; i < bucketCount; ++i)
+		{
+			const uint64_t hits = buckets[i].load(std::memory_order_relaxed);
+			if (!hits)
+				continue;
+
+			cumulative += hits;
+			callback(GetBucketMaxValue(i), cumulative);
+		}
+	}
+};
@@ -0,0 +1,415 @@
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#endif // _WIN32
+
+// minimal HTTP/1.1 server for local tooling, one thread per connection, keep-alive supported,
+// a handler can take over the connection after its reply, e.g. for a websocket
+// not meant to face the internet: no chunked request bodies, no TLS
+class CHttpServer
+{
+public:
+#ifdef _WIN32
+	typedef SOCKET socket_t;
+	static const socket_t invalidSocket = INVALID_SOCKET;
+#else
+	typedef int socket_t;
+	static const socket_t invalidSocket = -1;
+#endif // _WIN32
+
+	class CRequest
+	{
+	public:
+		std::string method;
+		std::string target;		// path and query
+		std::string body;
+		std::vector<std::pair<std::string, std::string>> headers;
+
+		// case insensitive, nullptr if missing
+		const char* GetHeader(const char* name) const
+		{
+			for (const auto& header : headers)
+			{
+				if (!_stricmp(header.first.c_str(), name))
+					return header.second.c_str();
+			}
+
+			return nullptr;
+		}
+
+		// path without the query
+		std::string GetPath() const
+		{
+			return target.substr(0, target.find('?'));
+		}
+	};
+
+	class CReply
+	{
+	public:
+		int status = 200;
+		std::string contentType = "text/plain; charset=utf-8";
+		std::vector<std::pair<std::string, std::string>> headers;
+		std::string body;
+
+		// runs on the connection's thread after a 101 reply, the connection is closed when it returns,
+		// it should return once stopping is set
+		std::function<void(socket_t sock, const std::atomic<bool>& stopping)> upgrade;
+	};
+
+	typedef std::function<void(const CRequest& request, CReply* reply)> Handler;
+
+private:
+	// request line and headers
+	static const size_t maxHeaderSz = 16 * 1024;
+	static const size_t maxBodySz = 4 * 1024 * 1024;
+
+	socket_t					listenSocket = invalidSocket;
+	Handler						handler;
+
+	std::thread					acceptThread;
+	std::atomic<bool>			stopping;
+
+	// connection threads are detached, Stop waits for this to reach zero
+	std::atomic<int>			connectionCount;
+
+	static void CloseSocket(socket_t sock)
+	{
+#ifdef _WIN32
+		closesocket(sock);
+#else
+		close(sock);
+#endif // _WIN32
+	}
+
+	static const char* GetStatusText(int status)
+	{
+		switch (status)
+		{
+		case 101: return "Switching Protocols";
+		case 200: return "OK";
+		case 204: return "No Content";
+		case 302: return "Found";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 413: return "Payload Too Large";
+		case 429: return "Too Many Requests";
+		case 500: return "Internal Server Error";
+		case 502: return "Bad Gateway";
+		case 503: return "Service Unavailable";
+		case 504: return "Gateway Timeout";
+		default: return "Unknown";
+		}
+	}
+
+	// parses the request line and headers, returns false on malformed input
+	static bool ParseHead(const std::string& head, CRequest* out)
+	{
+		size_t lineEnd = head.find("\r\n");
+		const std::string requestLine = head.substr(0, lineEnd);
+
+		const size_t methodEnd = requestLine.find(' ');
+		const size_t targetEnd = requestLine.find(' ', methodEnd + 1);
+		if (methodEnd == std::string::npos || targetEnd == std::string::npos)
+			return false;
+
+		out->method = requestLine.substr(0, methodEnd);
+		out->target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+		out->headers.clear();
+
+		while (lineEnd != std::string::npos)
+		{
+			const size_t lineStart = lineEnd + 2;
+			lineEnd = head.find("\r\n", lineStart);
+
+			const std::string line = head.substr(lineStart, lineEnd - lineStart);
+			if (line.empty())
+				break;
+
+			const size_t colon = line.find(':');
+			if (colon == std::string::npos)
+				return false;
+
+			const size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+
+			out->headers.emplace_back(line.substr(0, colon),
+				(valueStart == std::string::npos) ? std::string() : line.substr(valueStart));
+		}
+
+		return true;
+	}
+
+	void ServeConnection(socket_t sock)
+	{
+		HandleConnection(sock);
+		--connectionCount;
+	}
+
+	void HandleConnection(socket_t sock)
+	{
+		std::string buf;
+		char readBuf[16 * 1024];
+
+		while (!stopping)
+		{
+			// read until the end of the headers
+			size_t headEnd;
+			while ((headEnd = buf.find("\r\n\r\n")) == std::string::npos)
+			{
+				if (maxHeaderSz < buf.size() || stopping)
+				{
+					CloseSocket(sock);
+					return;
+				}
+
+				if (!WaitReadable(sock, 250))
+					continue;
+
+				const int readSz = recv(sock, readBuf, sizeof(readBuf), 0);
+				if (readSz <= 0)
+				{
+					CloseSocket(sock);
+					return;
+				}
+
+				buf.append(readBuf, readSz);
+			}
+
+			CRequest request;
+			CReply reply;
+
+			bool keepAlive = false;
+
+			if (!ParseHead(buf.substr(0, headEnd + 2), &request))
+				reply.status = 400;
+			else
+			{
+				const char* contentLength = request.GetHeader("Content-Length");
+				const size_t bodySz = contentLength ? strtoull(contentLength, nullptr, 10) : 0;
+
+				if (maxBodySz < bodySz)
+					reply.status = 413;
+				else
+				{
+					while (buf.size() < headEnd + 4 + bodySz && !stopping)
+					{
+						if (!WaitReadable(sock, 250))
+							continue;
+
+						const int readSz = recv(sock, readBuf, sizeof(readBuf), 0);
+						if (readSz <= 0)
+						{
+							CloseSocket(sock);
+							return;
+						}
+
+						buf.append(readBuf, readSz);
+					}
+
+					request.body = buf.substr(headEnd + 4, bodySz);
+					buf.erase(0, headEnd + 4 + bodySz);
+
+					const char* connection = request.GetHeader("Connection");
+					keepAlive = !(connection && !_stricmp(connection, "close"));
+
+					handler(request, &reply);
+
+					// status 0 drops the connection without a reply, e.g. to replay a failed request
+					if (!reply.status)
+						break;
+				}
+			}
+
+			const bool upgrade = (reply.status == 101 && reply.upgrade);
+
+			std::string head = "HTTP/1.1 " + std::to_string(reply.status) + ' ' + GetStatusText(reply.status) + "\r\n";
+
+			// the handler sends the Upgrade and Connection headers
+			if (!upgrade)
+			{
+				head += "Content-Type: " + reply.contentType + "\r\n";
+				head += "Content-Length: " + std::to_string(reply.body.size()) + "\r\n";
+			}
+
+			for (const auto& header : reply.headers)
+				head += header.first + ": " + header.second + "\r\n";
+
+			if (upgrade)
+			{
+				head += "\r\n";
+
+				if (SendAll(sock, head.data(), head.size()))
+					reply.upgrade(sock, stopping);
+
+				break;
+			}
+
+			head += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+			if (!SendAll(sock, head.data(), head.size()) ||
+				(request.method != "HEAD" && !SendAll(sock, reply.body.data(), reply.body.size())) ||
+				!keepAlive)
+			{
+				break;
+			}
+		}
+
+		CloseSocket(sock);
+	}
+
+	void AcceptMain()
+	{
+		while (!stopping)
+		{
+			if (!WaitReadable(listenSocket, 250))
+				continue;
+
+			const socket_t sock = accept(listenSocket, nullptr, nullptr);
+			if (sock == invalidSocket)
+				continue;
+
+			// replies are small and latency matters more than throughput
+			const int noDelay = 1;
+			setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+			++connectionCount;
+			std::thread(&CHttpServer::ServeConnection, this, sock).detach();
+		}
+	}
+
+public:
+	// waits until the socket is readable, false on timeout, also for upgraded connections
+	static bool WaitReadable(socket_t sock, int timeoutMs)
+	{
+#ifdef _WIN32
+		WSAPOLLFD pfd;
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+
+		return (0 < WSAPoll(&pfd, 1, timeoutMs));
+#else
+		pollfd pfd;
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+
+		return (0 < poll(&pfd, 1, timeoutMs));
+#endif // _WIN32
+	}
+
+	static bool SendAll(socket_t sock, const char* data, size_t size)
+	{
+		while (size)
+		{
+#ifdef _WIN32
+			const int sent = send(sock, data, (int)std::min<size_t>(size, INT_MAX), 0);
+#else
+			const ssize_t sent = send(sock, data, size, MSG_NOSIGNAL);
+#endif // _WIN32
+			if (sent <= 0)
+				return false;
+
+			data += sent;
+			size -= sent;
+		}
+
+		return true;
+	}
+
+	CHttpServer() : stopping(false), connectionCount(0)
+	{
+
+	}
+
+	~CHttpServer()
+	{
+		Stop();
+	}
+
+	CHttpServer(const CHttpServer&) = delete;
+	CHttpServer(const CHttpServer&&) = delete;
+
+	// address is a numeric IPv4 address, use 127.0.0.1 to only accept local connections
+	bool Start(const char* address, uint16_t port, Handler requestHandler)
+	{
+#ifdef _WIN32
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData))
+			return false;
+#endif // _WIN32
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+
+		if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+			return false;
+
+		listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listenSocket == invalidSocket)
+			return false;
+
+		const int reuseAddr = 1;
+		setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseAddr, sizeof(reuseAddr));
+
+		if (bind(listenSocket, (const sockaddr*)&addr, sizeof(addr)) || listen(listenSocket, SOMAXCONN))
+		{
+			CloseSocket(listenSocket);
+			listenSocket = invalidSocket;
+			return false;
+		}
+
+		handler = std::move(requestHandler);
+		stopping = false;
+		acceptThread = std::thread(&CHttpServer::AcceptMain, this);
+
+		return true;
+	}
+
+	// the port the server listens on, useful when started with port 0
+	uint16_t GetPort() const
+	{
+		sockaddr_in addr;
+		socklen_t addrSz = sizeof(addr);
+
+		if (getsockname(listenSocket, (sockaddr*)&addr, &addrSz))
+			return 0;
+
+		return ntohs(addr.sin_port);
+	}
+
+	bool IsRunning() const
+	{
+		return (listenSocket != invalidSocket);
+	}
+
+	void Stop()
+	{
+		if (listenSocket == invalidSocket)
+			return;
+
+		stopping = true;
+		acceptThread.join();
+
+		CloseSocket(listenSocket);
+		listenSocket = invalidSocket;
+
+		// connections notice within one poll interval
+		while (connectionCount)
+			std::this_thread::sleep_for(10ms);
+
+#ifdef _WIN32
+		WSACleanup();
+#endif // _WIN32
+	}
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+// per endpoint request timings recorded by the Market and Steam curl_easy_perform wrappers,
+// dumped on exit and on SIGUSR1
+namespace Latency
+{
+	enum class Phase
+	{
+		TOTAL,			// whole transfer, excluding rate limit wait
+		DNS,			// only recorded for new connections
+		CONNECT,		// TCP (or proxy) connect, only recorded for new connections
+		TLS,			// TLS handshake, only recorded for new connections
+		TTFB,			// request sent until the first response byte
+		RATE_LIMIT,		// time spent waiting for our own rate limiter
+
+		COUNT
+	};
+
+	const char* phaseNames[] =
+	{
+		"total",
+		"dns",
+		"connect",
+		"tls",
+		"ttfb",
+		"rate limit",
+	};
+
+	// labels are claimed once and never freed, there's a few dozen distinct endpoints
+	const size_t endpointCount = 64;
+
+	class CEndpoint
+	{
+	public:
+		enum State : uint32_t
+		{
+			EMPTY,
+			CLAIMING,
+			READY
+		};
+
+		std::atomic<uint32_t>	state;
+		char					label[Curl::endpointLabelBufSz];
+
+		CHistogram				phases[(size_t)Phase::COUNT];	// microseconds
+		CHistogram				bytes;							// downloaded + uploaded
+
+		CShardedCounter			okCount;
+		CShardedCounter			httpErrorCount;
+		CShardedCounter			curlErrorCount;
+	};
+
+	CEndpoint endpoints[endpointCount];
+
+	// requests that didn't fit into the table, label is "other"
+	CEndpoint overflowEndpoint;
+
+	inline uint32_t HashLabel(const char* label)
+	{
+		// FNV-1a
+		uint32_t hash = 2166136261u;
+
+		for (const char* iter = label; *iter; ++iter)
+		{
+			hash ^= (unsigned char)*iter;
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	// finds the label's slot or claims an empty one, open addressing with linear probing
+	CEndpoint* GetEndpoint(const char* label)
+	{
+		const size_t start = HashLabel(label) % endpointCount;
+
+		for (size_t i = 0; i < endpointCount; ++i)
+		{
+			CEndpoint* endpoint = &endpoints[(start + i) % endpointCount];
+
+			uint32_t state = endpoint->state.load(std::memory_order_acquire);
+
+			if (state == CEndpoint::EMPTY)
+			{
+				if (endpoint->state.compare_exchange_strong(state, CEndpoint::CLAIMING, std::memory_order_acquire))
+				{
+					strcpy(endpoint->label, label);
+					endpoint->state.store(CEndpoint::READY, std::memory_order_release);
+					return endpoint;
+				}
+			}
+
+			// someone else is writing the label, it might be ours
+			while (state == CEndpoint::CLAIMING)
+			{
+				std::this_thread::yield();
+				state = endpoint->state.load(std::memory_order_acquire);
+			}
+
+			if (!strcmp(endpoint->label, label))
+				return endpoint;
+		}
+
+		if (overflowEndpoint.state.load(std::memory_order_acquire) != CEndpoint::READY)
+		{
+			uint32_t state = CEndpoint::EMPTY;
+			if (overflowEndpoint.state.compare_exchange_strong(state, CEndpoint::CLAIMING, std::memory_order_acquire))
+			{
+				strcpy(overflowEndpoint.label, "other");
+				overflowEndpoint.state.store(CEndpoint::READY, std::memory_order_release);
+			}
+		}
+
+		return &overflowEndpoint;
+	}
+
+	// label from Curl::GetEndpointLabel
+	void Record(CURL* curl, const char* label, CURLcode respCode, std::chrono::microseconds rateLimitWait)
+	{
+		CEndpoint* endpoint = GetEndpoint(label);
+
+		if (respCode == CURLE_OK)
+			endpoint->okCount.Add();
+		else if (respCode == CURLE_HTTP_RETURNED_ERROR)
+			endpoint->httpErrorCount.Add();
+		else
+			endpoint->curlErrorCount.Add();
+
+		// all of these are measured from the start of the transfer
+		curl_off_t nameLookupTime = 0, connectTime = 0, appConnectTime = 0, preTransferTime = 0, startTransferTime = 0, totalTime = 0;
+		curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &nameLookupTime);
+		curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connectTime);
+		curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnectTime);
+		curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &preTransferTime);
+		curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &startTransferTime);
+		curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalTime);
+
+		long connectCount = 0;
+		curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connectCount);
+
+		CHistogram* phases = endpoint->phases;
+
+		phases[(size_t)Phase::TOTAL].Record(totalTime);
+		phases[(size_t)Phase::RATE_LIMIT].Record(rateLimitWait.count());
+
+		// reused connections report zeros, don't let them drag the percentiles down
+		if (connectCount && connectTime)
+		{
+			phases[(size_t)Phase::DNS].Record(nameLookupTime);
+			phases[(size_t)Phase::CONNECT].Record(connectTime - nameLookupTime);
+
+			if (appConnectTime)
+				phases[(size_t)Phase::TLS].Record(appConnectTime - connectTime);
+		}
+
+		if (startTransferTime)
+			phases[(size_t)Phase::TTFB].Record(startTransferTime - preTransferTime);
+
+		curl_off_t downloadSz = 0, uploadSz = 0;
+		curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloadSz);
+		curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploadSz);
+
+		endpoint->bytes.Record(downloadSz + uploadSz);
+	}
+
+	// calls callback(const CEndpoint*) for every endpoint that has recorded something
+	template <typename F>
+	void ForEachEndpoint(F callback)
+	{
+		for (const auto& endpoint : endpoints)
+		{
+			if (endpoint.state.load(std::memory_order_acquire) == CEndpoint::READY)
+				callback(&endpoint);
+		}
+
+		if (overflowEndpoint.state.load(std::memory_order_acquire) == CEndpoint::READY)
+			callback(&overflowEndpoint);
+	}
+
+	void Dump()
+	{
+		Log(LogChannel::GENERAL, "Request latencies (ms) per endpoint:\n");
+
+		ForEachEndpoint([](const CEndpoint* endpoint)
+		{
+			const uint64_t okCount = endpoint->okCount.Get();
+			const uint64_t httpErrorCount = endpoint->httpErrorCount.Get();
+			const uint64_t curlErrorCount = endpoint->curlErrorCount.Get();
+			const CHistogram& bytes = endpoint->bytes;
+
+			Log(LogChannel::GENERAL, "%s: %llu ok, %llu HTTP errors, %llu libcurl errors, %llu bytes avg\n",
+				endpoint->label,
+				(unsigned long long)okCount, (unsigned long long)httpErrorCount, (unsigned long long)curlErrorCount,
+				(unsigned long long)(bytes.GetCount() ? (bytes.GetSum() / bytes.GetCount()) : 0));
+
+			for (size_t i = 0; i < (size_t)Phase::COUNT; ++i)
+			{
+				const CHistogram& phase = endpoint->phases[i];
+				if (!phase.GetCount())
+					continue;
+
+				Log(LogChannel::GENERAL, "  %-10s n %-6llu p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f\n",
+					phaseNames[i],
+					(unsigned long long)phase.GetCount(),
+					phase.GetQuantile(0.50) / 1000.0,
+					phase.GetQuantile(0.90) / 1000.0,
+					phase.GetQuantile(0.99) / 1000.0,
+					phase.GetMax() / 1000.0);
+			}
+		});
+	}
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+thread_local const char* g_pszLogAccountName;
+
+class CLoggingContext
+{
+public:
+	CLoggingContext(const char* name) {
+		g_pszLogAccountName = name;
+	}
+	~CLoggingContext() {
+		g_pszLogAccountName = nullptr;
+	}
+};
+
+enum class LogChannel
+{
+	GENERAL,
+	LIBCURL,
+	STEAM,
+	MARKET
+};
+
+// Lines are collected per thread and handed to a writer thread through a lock-free ring buffer as one record,
+// so lines from different threads never interleave and logging never waits for the terminal or disk.
+// A line started with Log and continued with putsnn ("Saving..." + "ok\n") becomes one record once it ends with a newline.
+namespace Logger
+{
+	const size_t recordBufSz = 1024;
+	const size_t recordCount = 1024;
+
+	class CRecord
+	{
+	public:
+		time_t		timestamp;
+		bool		timestamped;	// started by Log, not bare putsnn
+		uint32_t	len;
+		char		text[recordBufSz];
+	};
+
+	CRingBuffer<CRecord, recordCount>	records;
+
+	std::atomic<size_t>					droppedCount(0);
+
+	std::thread							writerThread;
+	std::atomic<bool>					writerRunning(false);
+	std::atomic<bool>					writerStopping(false);
+	std::atomic<bool>					writerSleeping(false);
+	std::mutex							writerMutex;
+	std::condition_variable				writerCondVar;
+
+	// held by whoever writes to stdout, the writer thread or a thread logging while there's no writer thread
+	std::mutex							writeMutex;
+
+	// the line the current thread is putting together
+	thread_local CRecord				pending;
+	thread_local bool					hasPending = false;
+
+	// formatting the date is the expensive part and happens once a second at most
+	void WriteRecord(const CRecord* record)
+	{
+		if (record->timestamped)
+		{
+			static time_t cachedTimestamp = -1;
+
+			// zh_CN.utf8 locale's time on linux looks like this 2022年10月18日 15时08分28秒
+			// so allocate some space
+			static char dateTime[64];
+
+			if (record->timestamp != cachedTimestamp)
+			{
+				cachedTimestamp = record->timestamp;
+
+#ifdef _WIN32
+				// windows didn't support utf-8 codepages until recently, so map UTF-16 to UTF-8 instead
+				const size_t wideDatatimeLen = sizeof(dateTime);
+				wchar_t wideDatetime[wideDatatimeLen];
+				wcsftime(wideDatetime, wideDatatimeLen, L"%x %X", localtime(&record->timestamp));
+
+				if (!WideCharToMultiByte(CP_UTF8, 0, wideDatetime, -1, dateTime, sizeof(dateTime), NULL, NULL))
+					strcpy(dateTime, "timestamp UTF-16 to UTF-8 mapping failed");
+
+#else
+				tm localTime;
+				localtime_r(&record->timestamp, &localTime);
+				strftime(dateTime, sizeof(dateTime), "%x %X", &localTime);
+#endif // _WIN32
+			}
+
+			fputc('[', stdout);
+			fputs(dateTime, stdout);
+			fputs("] ", stdout);
+		}
+
+		fwrite(record->text, sizeof(char), record->len, stdout);
+	}
+
+	void WriterMain()
+	{
+		while (true)
+		{
+			{
+				std::lock_guard<std::mutex> lock(writeMutex);
+
+				bool wrote = false;
+
+				CRecord* record;
+				while ((record = records.Peek()))
+				{
+					WriteRecord(record);
+					records.Pop();
+					wrote = true;
+				}
+
+				const size_t dropped = droppedCount.exchange(0);
+				if (dropped)
+				{
+					fprintf(stdout, "[%zu log lines dropped, the log buffer was full]\n", dropped);
+					wrote = true;
+				}
+
+				if (wrote)
+					fflush(stdout);
+			}
+
+			if (writerStopping && records.IsEmpty())
+				break;
+
+			std::unique_lock<std::mutex> lock(writerMutex);
+
+			writerSleeping = true;
+
+			// a producer may have pushed right before we said we're sleeping, so don't sleep forever
+			if (records.IsEmpty() && !writerStopping)
+				writerCondVar.wait_for(lock, 50ms);
+
+			writerSleeping = false;
+		}
+	}
+
+	void Commit()
+	{
+		if (!hasPending)
+			return;
+
+		hasPending = false;
+
+		if (!writerRunning)
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+			WriteRecord(&pending);
+			return;
+		}
+
+		size_t pos;
+		CRecord* record = records.BeginPush(&pos);
+		if (!record)
+		{
+			// never wait for the writer, count it and let the writer report it
+			++droppedCount;
+			writerCondVar.notify_one();
+			return;
+		}
+
+		record->timestamp = pending.timestamp;
+		record->timestamped = pending.timestamped;
+		record->len = pending.len;
+		memcpy(record->text, pending.text, pending.len);
+
+		records.EndPush(pos);
+
+		if (writerSleeping)
+			writerCondVar.notify_one();
+	}
+
+	void Append(const char* text, size_t len)
+	{
+		if (!hasPending)
+		{
+			pending.timestamp = time(nullptr);
+			pending.timestamped = false;
+			pending.len = 0;
+			hasPending = true;
+		}
+
+		const size_t spaceLeft = sizeof(pending.text) - pending.len;
+
+		if (spaceLeft < len)
+		{
+			// keep the newline of a cut line
+			memcpy(pending.text + pending.len, text, spaceLeft);
+			pending.len += spaceLeft;
+
+			if (text[len - 1] == '\n')
+				pending.text[pending.len - 1] = '\n';
+		}
+		else
+		{
+			memcpy(pending.text + pending.len, text, len);
+			pending.len += len;
+		}
+
+		if (pending.len && pending.text[pending.len - 1] == '\n')
+			Commit();
+	}
+
+	void AppendV(const char* format, va_list args)
+	{
+		char buf[recordBufSz];
+
+		const int len = vsnprintf(buf, sizeof(buf), format, args);
+		if (len <= 0)
+			return;
+
+		Append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+	}
+
+	// writes out the current thread's unfinished line and waits for everything queued to be written,
+	// needed before prompting for input
+	void Flush()
+	{
+		Commit();
+
+		if (writerRunning)
+		{
+			while (!records.IsEmpty())
+			{
+				writerCondVar.notify_one();
+				std::this_thread::sleep_for(1ms);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(writeMutex);
+		fflush(stdout);
+	}
+
+	void Start()
+	{
+		if (writerRunning)
+			return;
+
+		writerStopping = false;
+		writerThread = std::thread(WriterMain);
+		writerRunning = true;
+	}
+
+	// writes out everything queued and goes back to writing synchronously
+	void Stop()
+	{
+		if (!writerRunning)
+			return;
+
+		Commit();
+
+		writerStopping = true;
+		writerCondVar.notify_one();
+		writerThread.join();
+
+		writerRunning = false;
+
+		fflush(stdout);
+	}
+
+	// keeps the writer thread running for its lifetime
+	class CWriterContext
+	{
+	public:
+		CWriterContext() {
+			Start();
+		}
+		~CWriterContext() {
+			Stop();
+		}
+	};
+}
+
+void Log(LogChannel channel, const char* format, ...)
+{
+	const char* logChannelNames[] =
+	{
+		"",
+		"libcurl",
+		"Steam",
+		"Market"
+	};
+
+	// previous line was never finished, end it so this one starts on its own
+	if (Logger::hasPending)
+		Logger::Append("\n", 1);
+
+	Logger::pending.timestamp = time(nullptr);
+	Logger::pending.timestamped = true;
+	Logger::pending.len = 0;
+	Logger::hasPending = true;
+
+	if (g_pszLogAccountName)
+	{
+		Logger::Append("[", 1);
+		Logger::Append(g_pszLogAccountName, strlen(g_pszLogAccountName));
+		Logger::Append("] ", 2);
+	}
+
+	if (channel != LogChannel::GENERAL)
+	{
+		const char* channelName = logChannelNames[(size_t)channel];
+
+		Logger::Append("[", 1);
+		Logger::Append(channelName, strlen(channelName));
+		Logger::Append("] ", 2);
+	}
+
+	va_list args;
+	va_start(args, format);
+	Logger::AppendV(format, args);
+	va_end(args);
+}
+
+// continues the line started by Log
+void LogAppend(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	Logger::AppendV(format, args);
+	va_end(args);
+}
+
+// puts without newline, continues the line started by Log
+inline int putsnn(const char* buf)
+{
+	Logger::Append(buf, strlen(buf));
+	return 0;
+}
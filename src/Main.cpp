@@ -1,11 +1,32 @@
 #include "Precompiled.h"
 #include <string>
+#include "RingBuffer.h"
+#include "Log.h"
 #include "Misc.h"
+#include "Clock.h"
 #include "Curl.h"
 #include "Crypto.h"
+#include "Counter.h"
+#include "Events.h"
+#include "Histogram.h"
+#include "Latency.h"
+#include "Trace.h"
+#include "SharedRateLimit.h"
+#include "RateLimiter.h"
+#include "Backoff.h"
+#include "Resolver.h"
+#include "ProxyPool.h"
+#include "SourceAddress.h"
+#include "HttpServer.h"
+#include "Capture.h"
+#include "Request.h"
 #include "Steam/Steam.h"
 #include "Market.h"
+#include "Push.h"
+#include "Sla.h"
+#include "Metrics.h"
 #include "Account.h"
+#include "Watcher.h"
 
 #define OPENMARKETCLIENT_VERSION "0.4.4"
 
@@ -31,7 +52,29 @@ namespace Args
 {
 	bool		newAcc = false;
 	bool		marketUseProxy = false;
+	bool		daemon = false;
+	bool		watchAccounts = false;
 	const char* proxy = nullptr;
+	const char* proxyFile = nullptr;
+	const char* sourceAddressFile = nullptr;
+	const char* sharedRateLimit = nullptr;
+	int			passwordFd = -1;
+	const char* passwordFile = nullptr;
+	const char* passwordEnv = nullptr;
+	const char* events = nullptr;
+	Events::Format eventsFormat = Events::Format::NDJSON;
+	uint64_t	eventsMaxSize = 64;	// MB
+	uint16_t	metricsPort = 0;
+	const char* trace = nullptr;
+	const char* baseUrl = nullptr;
+	const char* record = nullptr;
+	const char* replay = nullptr;
+	bool		replayTiming = false;
+	int			emptyMarketProbe = -1;	// minutes
+	int			pollMin = -1;			// seconds
+	int			pollMax = -1;			// seconds
+	bool		push = false;
+	bool		preResolve = false;
 
 	void PrintHelp()
 	{
@@ -40,7 +83,36 @@ namespace Args
 			"--new\t\t\t\t\t\t\tAdd a new account by manually entering the details\n"
 			"--proxy [scheme://][username:password@]host[:port]\tSets the global proxy\n"
 			"--market-use-proxy\t\t\t\t\tTells the market to perform actions using "
-				"the proxy specified in --proxy, presumably to avoid Steam bans\n");
+				"the proxy specified in --proxy, presumably to avoid Steam bans\n"
+			"--proxy-file [path]\t\t\t\t\tSpread the accounts over the proxies in this file, one per line, "
+				"and move an account off its proxy when the proxy goes down\n"
+			"--source-address-file [path]\t\t\t\tSpread the accounts over the local interfaces or addresses "
+				"in this file, one per line, \"account address\" pins an account\n"
+			"--shared-rate-limit [name]\t\t\t\tShare the rate limits with every instance on this host "
+				"started with the same name\n"
+			"--daemon\t\t\t\t\t\tRun without a terminal, never prompt for input, exit cleanly on SIGTERM/SIGHUP\n"
+			"--password-fd [fd]\t\t\t\t\tRead the encryption password from a file descriptor\n"
+			"--password-file [path]\t\t\t\t\tRead the encryption password from a file\n"
+			"--password-env [name]\t\t\t\t\tRead the encryption password from an environment variable\n"
+			"--watch-accounts\t\t\t\t\tAdd and remove accounts as their files appear in and disappear from "
+				"the accounts directory, keeps the encryption password in memory\n"
+			"--events [path]\t\t\t\t\t\tWrite trade events and failed requests to a file for analytics\n"
+			"--events-format [ndjson|binary]\t\t\t\tEvent file format, ndjson by default\n"
+			"--events-max-size [MB]\t\t\t\t\tRotate and gzip the event file when it grows past this size, "
+				"64 by default, 0 disables rotation\n"
+			"--metrics-port [port]\t\t\t\t\tServe Prometheus metrics on http://127.0.0.1:port/metrics\n"
+			"--trace [path]\t\t\t\t\t\tRecord where the time of every tick goes in Chrome Trace Event format\n"
+			"--base-url [http://host[:port]]\t\t\t\tSend all Market and Steam requests to this server instead, "
+				"e.g. the mock server, for testing only\n"
+			"--record [path]\t\t\t\t\t\tRecord every request and response to a capture file\n"
+			"--replay [path]\t\t\t\t\t\tAnswer every request from a capture file instead of the network\n"
+			"--replay-timing\t\t\t\t\t\tWait as long as the recorded request took before answering\n"
+			"--empty-market-probe [minutes]\t\t\t\tHow often markets without items are polled, 10 by default, at least 1\n"
+			"--poll-min [seconds]\t\t\t\t\tHow soon a market with sales, purchases or changes is polled again, "
+				"15 by default, at least 1\n"
+			"--poll-max [seconds]\t\t\t\t\tHow long polls of a quiet market back off to, 60 by default\n"
+			"--push\t\t\t\t\t\t\tPoll an account's markets as soon as the market reports a change over a websocket\n"
+			"--pre-resolve\t\t\t\t\t\tResolve the Market and Steam hosts in the background so requests never wait for DNS\n");
 	}
 
 	bool Parse(int argc, char** const argv)
@@ -58,6 +130,120 @@ namespace Args
 				newAcc = true;
 			else if (!strcmp(arg, "--market-use-proxy"))
 				marketUseProxy = true;
+			else if (!strcmp(arg, "--daemon"))
+				daemon = true;
+			else if (!strcmp(arg, "--watch-accounts"))
+				watchAccounts = true;
+			else if ((i < (argc - 1)) && !strcmp(arg, "--password-fd"))
+			{
+				const char* fd = argv[i + 1];
+				char* end;
+				errno = 0;
+				const long value = strtol(fd, &end, 10);
+
+				if (end == fd || *end || errno || value < 0 || INT_MAX < value)
+				{
+					Log(LogChannel::GENERAL, "Invalid password file descriptor: %s\n", fd);
+					return false;
+				}
+
+				passwordFd = (int)value;
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--password-file"))
+			{
+				passwordFile = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--password-env"))
+			{
+				passwordEnv = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--events"))
+			{
+				events = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--events-format"))
+			{
+				const char* format = argv[i + 1];
+
+				if (!strcmp(format, "ndjson"))
+					eventsFormat = Events::Format::NDJSON;
+				else if (!strcmp(format, "binary"))
+					eventsFormat = Events::Format::BINARY;
+				else
+					Log(LogChannel::GENERAL, "Unknown event format: %s\n", format);
+
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--events-max-size"))
+			{
+				eventsMaxSize = strtoull(argv[i + 1], nullptr, 10);
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--trace"))
+			{
+				trace = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--metrics-port"))
+			{
+				metricsPort = (uint16_t)atoi(argv[i + 1]);
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--base-url"))
+			{
+				baseUrl = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--record"))
+			{
+				record = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--replay"))
+			{
+				replay = argv[i + 1];
+				++i;
+			}
+			else if (!strcmp(arg, "--replay-timing"))
+				replayTiming = true;
+			else if ((i < (argc - 1)) && !strcmp(arg, "--empty-market-probe"))
+			{
+				emptyMarketProbe = atoi(argv[i + 1]);
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--poll-min"))
+			{
+				pollMin = atoi(argv[i + 1]);
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--poll-max"))
+			{
+				pollMax = atoi(argv[i + 1]);
+				++i;
+			}
+			else if (!strcmp(arg, "--push"))
+				push = true;
+			else if (!strcmp(arg, "--pre-resolve"))
+				preResolve = true;
+			else if ((i < (argc - 1)) && !strcmp(arg, "--proxy-file"))
+			{
+				proxyFile = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--source-address-file"))
+			{
+				sourceAddressFile = argv[i + 1];
+				++i;
+			}
+			else if ((i < (argc - 1)) && !strcmp(arg, "--shared-rate-limit"))
+			{
+				sharedRateLimit = argv[i + 1];
+				++i;
+			}
 			else if ((i < (argc - 1)) && !strcmp(arg, "--proxy")) // check if second to last argument
 			{
 				proxy = argv[i + 1];
@@ -90,76 +276,348 @@ bool SetWorkDirToExeDir()
 #endif // _WIN32
 }
 
-bool InitSavedAccounts(CURL* curl, const char* sessionId, const char* encryptPass, std::vector<CAccount>* accounts)
+// strips the trailing newline a file or a pipe usually has
+void TrimPasswordNewline(char* pass)
 {
-	const std::filesystem::path dir(CAccount::directory);
+	size_t len = strlen(pass);
+	while (len && (pass[len - 1] == '\n' || pass[len - 1] == '\r'))
+		pass[--len] = '\0';
+}
 
-	if (!std::filesystem::exists(dir))
-		return true;
+constexpr size_t encryptPassBufSz = 64;
+
+// reads the encryption password from the source given on the command line, or prompts for it
+// out buffer size must be at least encryptPassBufSz
+bool GetEncryptionPassword(char* out)
+{
+	const size_t outSz = encryptPassBufSz;
+	const size_t minLen = 10;
+	const size_t maxLen = outSz - 1;
+
+	if (Args::passwordFd < 0 && !Args::passwordFile && !Args::passwordEnv)
+		return GetUserInputString("Enter encryption password", out, outSz, minLen, false);
+
+	// one byte more than fits, so a password of exactly maxLen isn't mistaken for a truncated one
+	char buf[encryptPassBufSz + 1] = "";
+	const size_t bufSz = sizeof(buf);
 
 	bool success = true;
 
-	for (const auto& entry : std::filesystem::directory_iterator(dir))
+	if (0 <= Args::passwordFd)
 	{
-		const auto& path = entry.path();
-		const auto& extension = path.extension();
+		size_t len = 0;
 
-		const bool isMaFile = !extension.compare(".maFile");
+		while (len < bufSz - 1)
+		{
+			const int readSz = _read(Args::passwordFd, buf + len, bufSz - 1 - len);
+			if (readSz <= 0)
+				break;
 
-		if (extension.compare(CAccount::extension) && !isMaFile)
-			continue;
+			len += readSz;
 
-		const auto& stem = path.stem();
+			if (memchr(buf + len - readSz, '\n', readSz))
+				break;
+		}
 
-#ifdef _WIN32
-		const auto* widePath = path.c_str();
-		const auto* wideFilenameNoExt = stem.c_str();
+		buf[len] = '\0';
+	}
+	else if (Args::passwordFile)
+	{
+		unsigned char* contents = nullptr;
+		long contentsSz = 0;
+		if (ReadFile(Args::passwordFile, &contents, &contentsSz))
+		{
+			stpncpy(buf, (char*)contents, std::min<size_t>(contentsSz, bufSz - 1))[0] = '\0';
+
+			memset(contents, 0, contentsSz);
+			free(contents);
+		}
+		else
+		{
+			Log(LogChannel::GENERAL, "Reading encryption password file failed\n");
+			success = false;
+		}
+	}
+	else
+	{
+		const char* envPass = getenv(Args::passwordEnv);
+		if (envPass)
+			stpncpy(buf, envPass, bufSz - 1)[0] = '\0';
+		else
+		{
+			Log(LogChannel::GENERAL, "Encryption password environment variable %s isn't set\n", Args::passwordEnv);
+			success = false;
+		}
+	}
 
-		char szPath[PATH_MAX];
-		char szFilenameNoExt[PATH_MAX];
+	if (success)
+	{
+		TrimPasswordNewline(buf);
 
-		if (!WideCharToMultiByte(CP_UTF8, 0, widePath, -1, szPath, sizeof(szPath), NULL, NULL) ||
-			!WideCharToMultiByte(CP_UTF8, 0, wideFilenameNoExt, -1, szFilenameNoExt, sizeof(szFilenameNoExt), NULL, NULL))
+		const size_t len = strlen(buf);
+		if (len < minLen || maxLen < len)
 		{
-			Log(LogChannel::GENERAL, "One of the account's filename UTF-16 to UTF-8 mapping failed\n");
+			Log(LogChannel::GENERAL, "Encryption password must be %zu-%zu bytes\n", minLen, maxLen);
 			success = false;
-			break;
 		}
+		else
+			memcpy(out, buf, len + 1);
+	}
 
+	memset(buf, 0, bufSz);
+
+	if (!success)
+		memset(out, 0, outSz);
+
+	return success;
+}
+
+// returns the filename without extension of an account file, or false if it isn't one
+bool GetAccountFileName(const std::filesystem::path& path, char* outName, size_t outNameSz, bool* outIsMaFile)
+{
+	const auto& extension = path.extension();
+
+	const bool isMaFile = !extension.compare(".maFile");
+
+	if (extension.compare(CAccount::extension) && !isMaFile)
+		return false;
+
+	const auto& stem = path.stem();
+
+#ifdef _WIN32
+	if (!WideCharToMultiByte(CP_UTF8, 0, stem.c_str(), -1, outName, outNameSz, NULL, NULL))
+	{
+		// too long or not valid UTF-16, the name can't be shown as UTF-8 either
+		Log(LogChannel::GENERAL, "Skipping account file %ls: converting its name failed (error %lu)\n",
+			path.filename().c_str(), GetLastError());
+		return false;
+	}
 #else
-		const char* szPath = path.c_str();
-		const char* szFilenameNoExt = stem.c_str();
+	if (outNameSz <= stem.native().size())
+	{
+		// a truncated name could match another account's
+		Log(LogChannel::GENERAL, "Skipping account file %s: its name is too long\n", path.filename().c_str());
+		return false;
+	}
+
+	memcpy(outName, stem.c_str(), stem.native().size() + 1);
 #endif
 
-		CAccount account;
+	*outIsMaFile = isMaFile;
+	return true;
+}
+
+bool InitAccountFile(CURL* curl, const char* sessionId, const char* encryptPass,
+	const std::filesystem::path& path, std::vector<CAccount>* accounts)
+{
+	char szFilenameNoExt[PATH_MAX];
+	bool isMaFile;
+
+	if (!GetAccountFileName(path, szFilenameNoExt, sizeof(szFilenameNoExt), &isMaFile))
+		return true;
+
+#ifdef _WIN32
+	char szPath[PATH_MAX];
+
+	if (!WideCharToMultiByte(CP_UTF8, 0, path.c_str(), -1, szPath, sizeof(szPath), NULL, NULL))
+	{
+		Log(LogChannel::GENERAL, "One of the account's filename UTF-16 to UTF-8 mapping failed\n");
+		return false;
+	}
+
+#else
+	const char* szPath = path.c_str();
+#endif
+
+	CAccount account;
+
+	{
+		// logs in from the address the account will use
+		SourceAddress::CAccountScope sourceAddressScope(curl, szFilenameNoExt);
+		ProxyPool::CAccountScope proxyScope(curl, szFilenameNoExt);
 
 		if (!account.Init(curl, sessionId, encryptPass, szFilenameNoExt, szPath, isMaFile))
 		{
-			success = false;
-			break;
+			ProxyPool::Unassign(szFilenameNoExt);
+			SourceAddress::Unassign(szFilenameNoExt);
+			return false;
 		}
+	}
+
+	accounts->emplace_back(std::move(account));
+	return true;
+}
+
+bool InitSavedAccounts(CURL* curl, const char* sessionId, const char* encryptPass, std::vector<CAccount>* accounts)
+{
+	const std::filesystem::path dir(CAccount::directory);
 
-		accounts->emplace_back(account);
+	if (!std::filesystem::exists(dir))
+		return true;
+
+	for (const auto& entry : std::filesystem::directory_iterator(dir))
+	{
+		if (!InitAccountFile(curl, sessionId, encryptPass, entry.path(), accounts))
+			return false;
 	}
 
-	return success;
+	return true;
 }
 
-int main(int argc, char** argv)
+// initializes accounts dropped into the accounts directory and retires removed ones
+void HandleAccountFileEvents(CURL* curl, const char* sessionId, const char* encryptPass, 
+	const std::vector<CDirectoryWatcher::CEvent>& events, std::vector<CAccount>* accounts)
 {
-	// disable stdout buffering if stdout is a terminal
-	if (_isatty(_fileno(stdout)))
-		setvbuf(stdout, nullptr, _IONBF, 0);
+	for (const auto& event : events)
+	{
+		char name[PATH_MAX];
+		bool isMaFile;
 
-	SetLocale();
-	PrintVersion();
+		if (!GetAccountFileName(event.path, name, sizeof(name), &isMaFile))
+			continue;
+
+		auto iterAccount = std::find_if(accounts->begin(), accounts->end(),
+			[&name](const CAccount& account) { return !strcmp(account.GetName(), name); });
+
+		if (event.type == CDirectoryWatcher::EventType::ADDED)
+		{
+			// saving an already running account or the .bin written by maFile import
+			if (iterAccount != accounts->end())
+				continue;
 
+			std::error_code err;
+			if (!std::filesystem::exists(event.path, err))
+				continue;
+
+			Log(LogChannel::GENERAL, "New account file %s found, adding\n", name);
+
+			if (!InitAccountFile(curl, sessionId, encryptPass, event.path, accounts))
+				Log(LogChannel::GENERAL, "Adding account %s failed, fix the file to retry\n", name);
+		}
+		else
+		{
+			if (iterAccount == accounts->end())
+				continue;
+
+			// the maFile is removed after importing, the account lives on in its .bin
+			std::filesystem::path savedPath(event.path);
+			savedPath.replace_extension(CAccount::extension);
+
+			std::error_code err;
+			if (std::filesystem::exists(savedPath, err))
+				continue;
+
+			Log(LogChannel::GENERAL, "Account file %s removed, retiring the account\n", name);
+
+			Metrics::RemoveAccount(name);
+			ProxyPool::Unassign(name);
+			SourceAddress::Unassign(name);
+			accounts->erase(iterAccount);
+		}
+	}
+}
+
+// when the first account has something to do, a minute from now without accounts
+Clock::time_point GetNextTickTime(const std::vector<CAccount>& accounts)
+{
+	Clock::time_point nextTickTime = Clock::Now() + 1min;
+
+	for (const auto& account : accounts)
+		nextTickTime = std::min(nextTickTime, account.GetNextRunTime());
+
+	return nextTickTime;
+}
+
+// sleeps until the next account is due while handling account file changes
+void WaitForNextTick(CURL* curl, const char* sessionId, const char* encryptPass,
+	CDirectoryWatcher* watcher, std::vector<CAccount>* accounts)
+{
+	std::vector<CDirectoryWatcher::CEvent> events;
+
+	while (!g_nExitSignal)
+	{
+		if (g_bStatsDumpRequested)
+		{
+			g_bStatsDumpRequested = 0;
+			Latency::Dump();
+			Sla::Dump();
+		}
+
+		// added accounts are due right away
+		const auto nextTickTime = GetNextTickTime(*accounts);
+
+		const auto curTime = Clock::Now();
+		if (nextTickTime <= curTime)
+			break;
+
+		const auto timeout = std::min<std::chrono::milliseconds>(250ms,
+			std::chrono::duration_cast<std::chrono::milliseconds>(nextTickTime - curTime));
+
+		if (!watcher->IsActive())
+		{
+			Clock::SleepFor(timeout);
+			continue;
+		}
+
+		events.clear();
+		watcher->Wait(timeout, &events);
+
+		if (!events.empty())
+			HandleAccountFileEvents(curl, sessionId, encryptPass, events, accounts);
+	}
+}
+
+int main(int argc, char** argv)
+{
 	if (!Args::Parse(argc, argv))
 	{
 		Pause();
 		return 0;
 	}
 
+	g_bNonInteractive = Args::daemon;
+
+	if (g_bNonInteractive && Args::newAcc)
+		Log(LogChannel::GENERAL, "--new is ignored when running as a daemon\n");
+
+	// there's no fixed tick, a zero interval would poll in a loop
+	if (!Args::emptyMarketProbe || !Args::pollMin)
+		Log(LogChannel::GENERAL, "--empty-market-probe and --poll-min must be at least 1, using 1\n");
+
+	if (0 <= Args::emptyMarketProbe)
+		CAccount::emptyMarketProbeInterval = std::chrono::minutes(std::max(Args::emptyMarketProbe, 1));
+
+	if (0 <= Args::pollMin)
+		CAccount::pollIntervalMin = std::chrono::seconds(std::max(Args::pollMin, 1));
+
+	if (0 <= Args::pollMax)
+		CAccount::pollIntervalMax = std::chrono::seconds(Args::pollMax);
+
+	if (CAccount::pollIntervalMax < CAccount::pollIntervalMin)
+	{
+		Log(LogChannel::GENERAL, "--poll-max is less than --poll-min, using --poll-min for both\n");
+		CAccount::pollIntervalMax = CAccount::pollIntervalMin;
+	}
+
+	// the log writer flushes after every batch of lines, so buffer everything in between when it goes to a file
+	// or a supervisor's log collector, which then doesn't get lines in pieces either.
+	// a terminal stays unbuffered so prompts show up without a flush before every read
+	if (g_bNonInteractive || !_isatty(_fileno(stdout)))
+		setvbuf(stdout, nullptr, _IOFBF, BUFSIZ);
+
+	// writes out everything logged when main returns
+	Logger::CWriterContext logWriter;
+
+	// interactive setup prompts and retries until an account works, Ctrl-C has to end it there,
+	// the handlers take over once the main loop can stop cleanly
+	if (g_bNonInteractive)
+		SetExitSignalHandlers();
+
+	SetStatsDumpSignalHandler();
+
+	SetLocale();
+	PrintVersion();
+
 	if (!SetWorkDirToExeDir())
 	{
 		Log(LogChannel::GENERAL, "Setting working directory failed\n");
@@ -167,6 +625,60 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	// writes out queued events when main returns
+	Events::CSinkContext eventSink;
+
+	if (Args::events && !Events::Start(Args::events, Args::eventsFormat, Args::eventsMaxSize * 1024 * 1024))
+	{
+		Pause();
+		return 1;
+	}
+
+	// finishes the trace file when main returns
+	Trace::CTraceContext traceContext;
+
+	if (Args::trace && !Trace::Start(Args::trace))
+	{
+		Pause();
+		return 1;
+	}
+
+	// stops serving when main returns
+	CHttpServer metricsServer;
+
+	if (Args::metricsPort && !Metrics::Start(&metricsServer, Args::metricsPort))
+	{
+		Pause();
+		return 1;
+	}
+
+	// stops serving when main returns
+	CHttpServer replayServer;
+
+	if (Args::replay)
+	{
+		if (Args::baseUrl)
+			Log(LogChannel::GENERAL, "--base-url is ignored when replaying\n");
+
+		if (!Capture::StartReplay(&replayServer, Args::replay, Args::replayTiming))
+		{
+			Pause();
+			return 1;
+		}
+
+		// --replay-timing keeps the rate limits so a tick takes as long as it did live, otherwise nothing waits
+		if (!Args::replayTiming)
+		{
+			Market::requestInterval = 0us;
+			Steam::requestInterval = 0us;
+		}
+	}
+	else if (Args::baseUrl && !Curl::SetBaseUrl(Args::baseUrl))
+	{
+		Pause();
+		return 1;
+	}
+
 	CURL* curl = Curl::Init(Args::proxy);
 	if (!curl)
 	{
@@ -174,6 +686,61 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	// the override server is local
+	if (Args::preResolve && (Args::baseUrl || Args::replay))
+		Log(LogChannel::GENERAL, "--pre-resolve is ignored with --base-url and --replay\n");
+	else if (Args::preResolve)
+		Resolver::Start();
+
+	ProxyPool::defaultProxy = Args::proxy;
+
+	if (Args::proxyFile && !ProxyPool::Load(Args::proxyFile))
+	{
+		curl_easy_cleanup(curl);
+		curl_global_cleanup();
+		Pause();
+		return 1;
+	}
+
+	if (Args::sourceAddressFile && !SourceAddress::Load(Args::sourceAddressFile))
+	{
+		curl_easy_cleanup(curl);
+		curl_global_cleanup();
+		Pause();
+		return 1;
+	}
+
+	// once the routes are known, before the first request creates its rate limiter
+	if (Args::sharedRateLimit)
+	{
+		std::vector<std::string> limiterNames;
+
+		for (const auto& route : SourceAddress::GetRoutes())
+		{
+			limiterNames.push_back(Market::rateLimiters.GetLimiterName(route.c_str()));
+			limiterNames.push_back(Steam::rateLimiters.GetLimiterName(route.c_str()));
+		}
+
+		if (!SharedRateLimit::Start(Args::sharedRateLimit, limiterNames))
+		{
+			curl_easy_cleanup(curl);
+			curl_global_cleanup();
+			Pause();
+			return 1;
+		}
+	}
+
+	// finishes the capture file when main returns
+	Capture::CRecordingContext recordingContext;
+
+	if (Args::record && !Capture::StartRecording(curl, Args::record))
+	{
+		curl_easy_cleanup(curl);
+		curl_global_cleanup();
+		Pause();
+		return 1;
+	}
+
 	char sessionId[Steam::sessionIdBufSz];
 
 	if (!Steam::GenerateSessionId(sessionId) || !Steam::SetSessionCookie(curl, sessionId))
@@ -192,9 +759,20 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
-	char encryptPass[64];
-	if (!GetUserInputString("Enter encryption password", encryptPass, sizeof(encryptPass), 10, false))
+	char encryptPass[encryptPassBufSz];
+	if (!GetEncryptionPassword(encryptPass))
+	{
+		curl_easy_cleanup(curl);
+		curl_global_cleanup();
+		Pause();
+		return 1;
+	}
+
+	// start watching before loading so files dropped meanwhile aren't missed
+	CDirectoryWatcher watcher;
+	if (Args::watchAccounts && !watcher.Init(CAccount::directory))
 	{
+		memset(encryptPass, 0, sizeof(encryptPass));
 		curl_easy_cleanup(curl);
 		curl_global_cleanup();
 		Pause();
@@ -203,12 +781,12 @@ int main(int argc, char** argv)
 
 	std::vector<CAccount> accounts;
 
-	if (Args::newAcc)
+	if (Args::newAcc && !g_bNonInteractive)
 	{
 		CAccount account;
 		while (!account.Init(curl, sessionId, encryptPass));
 
-		accounts.emplace_back(account);
+		accounts.emplace_back(std::move(account));
 	}
 
 	if (!InitSavedAccounts(curl, sessionId, encryptPass, &accounts))
@@ -219,38 +797,101 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
-	if (accounts.empty())
+	if (accounts.empty() && g_bNonInteractive && !watcher.IsActive())
+	{
+		memset(encryptPass, 0, sizeof(encryptPass));
+		curl_easy_cleanup(curl);
+		curl_global_cleanup();
+		Log(LogChannel::GENERAL, "No accounts, add one interactively before running as a daemon\n");
+		return 1;
+	}
+
+	if (accounts.empty() && !g_bNonInteractive)
 	{
 		Log(LogChannel::GENERAL, "No accounts, adding a new one\n");
 
 		CAccount account;
 		while (!account.Init(curl, sessionId, encryptPass));
 
-		accounts.emplace_back(account);
+		accounts.emplace_back(std::move(account));
 	}
 
-	memset(encryptPass, 0, sizeof(encryptPass));
+	// new accounts need it later
+	if (!watcher.IsActive())
+		memset(encryptPass, 0, sizeof(encryptPass));
 
 #ifdef _WIN32
 	// prevent sleep
 	SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED);
 #endif // _WIN32
 
-	const char* marketProxy = Args::marketUseProxy ? Args::proxy : nullptr;
+	if (!g_bNonInteractive)
+		SetExitSignalHandlers();
+
+	std::thread timeDriftThread = Steam::Guard::StartTimeDriftTracking(curl);
 
-	const size_t accountCount = accounts.size();
+	// without the probes a proxy that went down is never used again
+	if (Args::proxyFile)
+		ProxyPool::Start(curl);
 
-	while (true)
+	// the scheduled polls go on without it
+	if (Args::push)
+		Push::Start(curl);
+
+	while (!g_nExitSignal)
 	{
-		for (size_t i = 0; i < accountCount; ++i)
-			accounts[i].RunMarkets(curl, sessionId, marketProxy);
+		const auto tickStartTime = std::chrono::steady_clock::now();
+
+		size_t accountRunCount = 0;
+
+		// finish the account that's running so no trade is left half done
+		for (size_t i = 0; i < accounts.size() && !g_nExitSignal; ++i)
+		{
+			if (Clock::Now() < accounts[i].GetNextRunTime())
+				continue;
+
+			SourceAddress::CAccountScope sourceAddressScope(curl, accounts[i].GetName());
+			ProxyPool::CAccountScope proxyScope(curl, accounts[i].GetName());
+
+			accounts[i].RunMarkets(curl, sessionId, Args::marketUseProxy ? proxyScope.GetProxy() : nullptr);
+			++accountRunCount;
+		}
+
+		int64_t accountOkCount = 0;
+		for (const auto& account : accounts)
+		{
+			if (account.IsLastRunOk())
+				++accountOkCount;
+		}
+
+		Metrics::tickDuration.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - tickStartTime).count());
+		Metrics::ticksCompleted.Add();
+		Metrics::accountCount = accounts.size();
+		Metrics::accountOkCount = accountOkCount;
 
-		if (1 < accountCount)
-			putchar('\n');
+		if (1 < accountRunCount)
+			putsnn("\n");
 
-		std::this_thread::sleep_for(1min);
+		WaitForNextTick(curl, sessionId, encryptPass, &watcher, &accounts);
 	}
 
+	memset(encryptPass, 0, sizeof(encryptPass));
+
+	Log(LogChannel::GENERAL, "Received signal %d, exiting\n", (int)g_nExitSignal);
+
+	if (timeDriftThread.joinable())
+		timeDriftThread.join();
+
+	Push::Stop();
+	ProxyPool::Stop();
+	Resolver::Stop();
+
+	Latency::Dump();
+	Sla::Dump();
+
+	Logger::Flush();
+
 	curl_easy_cleanup(curl);
 	curl_global_cleanup();
 	Pause();
@@ -35,6 +35,8 @@ namespace Market
 		"https://gifts.tm/api/v2/",
 	};
 
+	static_assert((size_t)Market::COUNT <= Events::maxMarketCount, "raise Events::maxMarketCount");
+
 	const size_t marketBaseUrlMaxSz = sizeof("https://market.dota2.net/api/v2/");
 
 	//const bool isMarketP2P[] =
@@ -57,21 +59,28 @@ namespace Market
 		WAITING_ACCEPT
 	};
 	
-	void RateLimit()
+	// spacing between market requests, benchmarks against the mock server set it to zero
+	std::chrono::microseconds requestInterval = 1s;
+
+	CRateLimiterSet rateLimiters("Market");
+
+	// the market whose API the host serves, -1 for other hosts
+	int GetMarketOfHost(const std::string& host)
 	{
-		static std::chrono::high_resolution_clock::time_point nextRequestTime;
-		std::this_thread::sleep_until(nextRequestTime);
+		for (size_t i = 0; i < std::size(marketBaseUrls); ++i)
+		{
+			const char* baseHost = Curl::GetHostAndPath(marketBaseUrls[i]);
+
+			if (!strncmp(baseHost, host.c_str(), host.size()) && baseHost[host.size()] == '/')
+				return (int)i;
+		}
 
-		const auto curTime = std::chrono::high_resolution_clock::now();
-		const auto requestInterval = 1s;
-		nextRequestTime = curTime + requestInterval;
+		return -1;
 	}
 
 	CURLcode curl_easy_perform(CURL* curl)
 	{
-		RateLimit();
-
-		return ::curl_easy_perform(curl);
+		return Curl::Perform(curl, &rateLimiters, requestInterval, GetMarketOfHost(Curl::requestHost));
 	}
 
 	// deprecated
@@ -87,7 +96,7 @@ namespace Market
 		urlEnd = stpcpy(urlEnd, query);
 		strcpy(urlEnd, apiKey);
 
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
 
 		return (curl_easy_perform(curl) == CURLE_OK);
@@ -123,7 +132,7 @@ namespace Market
 		jsonDoc.Accept(writer);
 		const char* jsonStr = buffer.GetString();
 
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonStr);
 		
 		curl_slist* headers = NULL;
@@ -170,6 +179,51 @@ namespace Market
 		return true;
 	}
 
+	// notifications about the account's items of every market, see Push.h
+	const char wsUrl[] = "wss://wsn.dota2.net/wsn/";
+	const size_t wsAuthBufSz = 128;
+
+	// outToken buffer size must be at least wsAuthBufSz
+	bool GetWsAuth(CURL* curl, const char* apiKey, char* outToken)
+	{
+		const char query[] = "get-ws-auth?key=";
+
+		const size_t urlBufSz = marketBaseUrlMaxSz - 1 + sizeof(query) - 1 + apiKeySz + 1;
+		char url[urlBufSz];
+
+		char* urlEnd = url;
+		urlEnd = stpcpy(urlEnd, marketBaseUrls[(int)Market::CSGO]);
+		urlEnd = stpcpy(urlEnd, query);
+		strcpy(urlEnd, apiKey);
+
+		Curl::CResponse response;
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+		Curl::SetUrl(curl, url);
+		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+
+		if (curl_easy_perform(curl) != CURLE_OK)
+			return false;
+
+		rapidjson::Document parsed;
+		parsed.ParseInsitu(response.data);
+
+		if (parsed.HasParseError() || !parsed.IsObject())
+			return false;
+
+		const auto iterSuccess = parsed.FindMember("success");
+		const auto iterToken = parsed.FindMember("wsAuth");
+
+		if (iterSuccess == parsed.MemberEnd() || !iterSuccess->value.IsBool() || !iterSuccess->value.GetBool() ||
+			iterToken == parsed.MemberEnd() || !iterToken->value.IsString() ||
+			wsAuthBufSz <= iterToken->value.GetStringLength())
+		{
+			return false;
+		}
+
+		strcpy(outToken, iterToken->value.GetString());
+		return true;
+	}
+
 	bool GetItems(CURL* curl, const char* apiKey, int market, rapidjson::Document* outDoc)
 	{
 		const char query[] = "items?key=";
@@ -184,7 +238,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		if (curl_easy_perform(curl) != CURLE_OK)
@@ -224,7 +278,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -274,7 +328,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -331,7 +385,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -387,7 +441,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -433,7 +487,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -521,7 +575,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -574,7 +628,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
@@ -651,7 +705,7 @@ namespace Market
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		const CURLcode respCode = curl_easy_perform(curl);
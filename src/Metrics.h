@@ -0,0 +1,319 @@
+#pragma once
+
+// Prometheus text format metrics served on localhost with --metrics-port
+// counters are sharded per thread and summed when scraped, so workers never wait for a scrape
+namespace Metrics
+{
+	CShardedCounter			ticksCompleted;
+	CHistogram				tickDuration;	// microseconds
+
+	std::atomic<int64_t>	accountCount(0);
+	std::atomic<int64_t>	accountOkCount(0);	// accounts whose last RunMarkets succeeded
+
+	// written once per account per tick, the lock is only held for a copy
+	std::mutex listingsMutex;
+	std::vector<std::pair<std::string, std::array<uint32_t, (size_t)Market::Market::COUNT>>> listings;
+
+	void SetListings(const char* account, const rapidjson::SizeType* itemCounts)
+	{
+		std::lock_guard<std::mutex> lock(listingsMutex);
+
+		auto iter = std::find_if(listings.begin(), listings.end(),
+			[account](const auto& entry) { return (entry.first == account); });
+
+		if (iter == listings.end())
+		{
+			listings.emplace_back(account, std::array<uint32_t, (size_t)Market::Market::COUNT>());
+			iter = listings.end() - 1;
+		}
+
+		for (size_t i = 0; i < (size_t)Market::Market::COUNT; ++i)
+			iter->second[i] = itemCounts[i];
+	}
+
+	void RemoveAccount(const char* account)
+	{
+		std::lock_guard<std::mutex> lock(listingsMutex);
+
+		listings.erase(std::remove_if(listings.begin(), listings.end(),
+			[account](const auto& entry) { return (entry.first == account); }), listings.end());
+	}
+
+	void AppendLabelValue(std::string* out, const char* value)
+	{
+		out->push_back('"');
+
+		for (const char* iter = value; *iter; ++iter)
+		{
+			if (*iter == '\\' || *iter == '"')
+			{
+				out->push_back('\\');
+				out->push_back(*iter);
+			}
+			else if (*iter == '\n')
+				out->append("\\n");
+			else
+				out->push_back(*iter);
+		}
+
+		out->push_back('"');
+	}
+
+	void AppendHeader(std::string* out, const char* name, const char* type, const char* help)
+	{
+		out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+		out->append("# TYPE ").append(name).append(" ").append(type).append("\n");
+	}
+
+	void AppendSample(std::string* out, const char* name, const char* labels, double value)
+	{
+		char valueStr[32];
+		snprintf(valueStr, sizeof(valueStr), "%.17g", value);
+
+		out->append(name);
+
+		if (labels && labels[0])
+			out->append("{").append(labels).append("}");
+
+		out->append(" ").append(valueStr).append("\n");
+	}
+
+	// quantiles, sum and count of a histogram recorded in microseconds, in seconds
+	void AppendSummary(std::string* out, const char* name, const std::string& labels, const CHistogram& histogram)
+	{
+		const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+		for (const double quantile : quantiles)
+		{
+			char quantileLabel[32];
+			snprintf(quantileLabel, sizeof(quantileLabel), "quantile=\"%g\"", quantile);
+
+			const std::string allLabels = labels.empty() ? quantileLabel : (labels + ',' + quantileLabel);
+			AppendSample(out, name, allLabels.c_str(), histogram.GetQuantile(quantile) / 1e6);
+		}
+
+		const std::string sumName = std::string(name) + "_sum";
+		const std::string countName = std::string(name) + "_count";
+		AppendSample(out, sumName.c_str(), labels.c_str(), histogram.GetSum() / 1e6);
+		AppendSample(out, countName.c_str(), labels.c_str(), (double)histogram.GetCount());
+	}
+
+	std::string Format()
+	{
+		std::string out;
+		out.reserve(16 * 1024);
+
+		AppendHeader(&out, "omc_accounts", "gauge", "Accounts loaded");
+		AppendSample(&out, "omc_accounts", nullptr, (double)accountCount);
+
+		AppendHeader(&out, "omc_accounts_ok", "gauge", "Accounts whose last tick finished without errors");
+		AppendSample(&out, "omc_accounts_ok", nullptr, (double)accountOkCount);
+
+		AppendHeader(&out, "omc_ticks_total", "counter", "Ticks completed");
+		AppendSample(&out, "omc_ticks_total", nullptr, (double)ticksCompleted.Get());
+
+		AppendHeader(&out, "omc_tick_duration_seconds", "summary", "Time to run the markets of every account once");
+		AppendSummary(&out, "omc_tick_duration_seconds", std::string(), tickDuration);
+
+		AppendHeader(&out, "omc_listings", "gauge", "Items listed per account and market as of the last tick");
+		{
+			std::unique_lock<std::mutex> lock(listingsMutex);
+			const auto listingsCopy = listings;
+			lock.unlock();
+
+			for (const auto& entry : listingsCopy)
+			{
+				for (size_t i = 0; i < (size_t)Market::Market::COUNT; ++i)
+				{
+					std::string labels = "account=";
+					AppendLabelValue(&labels, entry.first.c_str());
+					labels.append(",market=");
+					AppendLabelValue(&labels, Market::marketNames[i]);
+
+					AppendSample(&out, "omc_listings", labels.c_str(), entry.second[i]);
+				}
+			}
+		}
+
+		AppendHeader(&out, "omc_events_total", "counter", "Trade events and failed requests");
+		for (size_t type = 0; type < (size_t)Events::EventType::COUNT; ++type)
+		{
+			for (size_t market = 0; market <= (size_t)Market::Market::COUNT; ++market)
+			{
+				const uint64_t count = Events::emittedCounts[type][market].Get();
+				if (!count)
+					continue;
+
+				std::string labels = "type=";
+				AppendLabelValue(&labels, Events::eventTypeNames[type]);
+
+				if (market)
+				{
+					labels.append(",market=");
+					AppendLabelValue(&labels, Market::marketNames[market - 1]);
+				}
+
+				AppendSample(&out, "omc_events_total", labels.c_str(), (double)count);
+			}
+		}
+
+		AppendHeader(&out, "omc_requests_total", "counter", "Requests per endpoint and result");
+		Latency::ForEachEndpoint([&out](const Latency::CEndpoint* endpoint)
+		{
+			const std::pair<const char*, uint64_t> results[] =
+			{
+				{ "ok", endpoint->okCount.Get() },
+				{ "http_error", endpoint->httpErrorCount.Get() },
+				{ "curl_error", endpoint->curlErrorCount.Get() },
+			};
+
+			for (const auto& result : results)
+			{
+				std::string labels = "endpoint=";
+				AppendLabelValue(&labels, endpoint->label);
+				labels.append(",result=\"").append(result.first).append("\"");
+
+				AppendSample(&out, "omc_requests_total", labels.c_str(), (double)result.second);
+			}
+		});
+
+		AppendHeader(&out, "omc_request_duration_seconds", "summary", "Request duration per endpoint, excluding rate limit wait");
+		Latency::ForEachEndpoint([&out](const Latency::CEndpoint* endpoint)
+		{
+			std::string labels = "endpoint=";
+			AppendLabelValue(&labels, endpoint->label);
+
+			AppendSummary(&out, "omc_request_duration_seconds", labels, endpoint->phases[(size_t)Latency::Phase::TOTAL]);
+		});
+
+		AppendHeader(&out, "omc_rate_limit_wait_seconds", "summary", "Time requests spent waiting for the rate limiter");
+		Latency::ForEachEndpoint([&out](const Latency::CEndpoint* endpoint)
+		{
+			std::string labels = "endpoint=";
+			AppendLabelValue(&labels, endpoint->label);
+
+			AppendSummary(&out, "omc_rate_limit_wait_seconds", labels, endpoint->phases[(size_t)Latency::Phase::RATE_LIMIT]);
+		});
+
+		AppendHeader(&out, "omc_host_rate", "gauge", "Requests per second a host is throttled to after 429s and 5xxs, 0 while unthrottled");
+		Backoff::ForEachHost([&out](const std::string& name, const Backoff::CHost& host)
+		{
+			std::string labels = "host=";
+			AppendLabelValue(&labels, name.c_str());
+
+			AppendSample(&out, "omc_host_rate", labels.c_str(), host.rate);
+		});
+
+		AppendHeader(&out, "omc_host_circuit_open", "gauge", "1 while requests to a host are paused because it seems to be down");
+		Backoff::ForEachHost([&out](const std::string& name, const Backoff::CHost& host)
+		{
+			std::string labels = "host=";
+			AppendLabelValue(&labels, name.c_str());
+
+			AppendSample(&out, "omc_host_circuit_open", labels.c_str(), (host.circuitState == Backoff::CircuitState::CLOSED) ? 0 : 1);
+		});
+
+		AppendHeader(&out, "omc_host_requests_total", "counter", "Requests per host that were throttled by a 429 or 5xx, or skipped because the host was down");
+		Backoff::ForEachHost([&out](const std::string& name, const Backoff::CHost& host)
+		{
+			const std::pair<const char*, uint64_t> results[] =
+			{
+				{ "throttled", host.throttledCount.Get() },
+				{ "skipped", host.skippedCount.Get() },
+			};
+
+			for (const auto& result : results)
+			{
+				std::string labels = "host=";
+				AppendLabelValue(&labels, name.c_str());
+				labels.append(",result=\"").append(result.first).append("\"");
+
+				AppendSample(&out, "omc_host_requests_total", labels.c_str(), (double)result.second);
+			}
+		});
+
+		AppendHeader(&out, "omc_proxy_up", "gauge", "1 while a --proxy-file proxy passes its health probes");
+		ProxyPool::ForEachProxy([&out](const ProxyPool::CProxy& proxy)
+		{
+			std::string labels = "proxy=";
+			AppendLabelValue(&labels, proxy.label.c_str());
+
+			AppendSample(&out, "omc_proxy_up", labels.c_str(), proxy.up ? 1 : 0);
+		});
+
+		AppendHeader(&out, "omc_proxy_latency_seconds", "gauge", "Moving average of request and probe duration per proxy");
+		ProxyPool::ForEachProxy([&out](const ProxyPool::CProxy& proxy)
+		{
+			std::string labels = "proxy=";
+			AppendLabelValue(&labels, proxy.label.c_str());
+
+			AppendSample(&out, "omc_proxy_latency_seconds", labels.c_str(), proxy.latencyMs / 1000);
+		});
+
+		AppendHeader(&out, "omc_proxy_accounts", "gauge", "Accounts assigned per proxy");
+		ProxyPool::ForEachProxy([&out](const ProxyPool::CProxy& proxy)
+		{
+			std::string labels = "proxy=";
+			AppendLabelValue(&labels, proxy.label.c_str());
+
+			AppendSample(&out, "omc_proxy_accounts", labels.c_str(), (double)proxy.accountCount);
+		});
+
+		AppendHeader(&out, "omc_delivery_seconds", "summary", "Time from a sale or purchase showing up until our part of the trade is done, per stage");
+		Sla::ForEachStats([&out](const Sla::CStats* entry)
+		{
+			for (size_t i = 0; i < (size_t)Sla::Stage::COUNT; ++i)
+			{
+				if (!entry->stages[i].GetCount())
+					continue;
+
+				std::string labels = "account=";
+				AppendLabelValue(&labels, entry->account.c_str());
+				labels.append(",market=");
+				AppendLabelValue(&labels, Market::marketNames[entry->market]);
+				labels.append(",stage=");
+				AppendLabelValue(&labels, Sla::stageNames[i]);
+
+				AppendSummary(&out, "omc_delivery_seconds", labels, entry->stages[i]);
+			}
+		});
+
+		AppendHeader(&out, "omc_steam_time_drift_ms_per_hour", "gauge", "Local clock drift relative to Steam time");
+		AppendSample(&out, "omc_steam_time_drift_ms_per_hour", nullptr, (double)Steam::Guard::GetTimeDriftMsPerHour());
+
+		return out;
+	}
+
+	void HandleRequest(const CHttpServer::CRequest& request, CHttpServer::CReply* reply)
+	{
+		if (request.method != "GET" && request.method != "HEAD")
+		{
+			reply->status = 405;
+			return;
+		}
+
+		if (request.GetPath() != "/metrics")
+		{
+			reply->status = 404;
+			return;
+		}
+
+		reply->contentType = "text/plain; version=0.0.4; charset=utf-8";
+		reply->body = Format();
+	}
+
+	// only listens on localhost, there's no authentication
+	bool Start(CHttpServer* server, uint16_t port)
+	{
+		Log(LogChannel::GENERAL, "Serving metrics on 127.0.0.1:%u...", (unsigned)port);
+
+		if (!server->Start("127.0.0.1", port, HandleRequest))
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		putsnn("ok\n");
+		return true;
+	}
+}
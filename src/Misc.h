@@ -1,79 +1,19 @@
 #pragma once
 
-// puts without newline
-inline int putsnn(const char* buf)
-{
-	return fputs(buf, stdout);
-}
-
-thread_local const char* g_pszLogAccountName;
-
-class CLoggingContext
-{
-public:
-	CLoggingContext(const char* name) {
-		g_pszLogAccountName = name;
-	}
-	~CLoggingContext() {
-		g_pszLogAccountName = nullptr;
-	}
-};
+// set in daemon mode, nothing may wait for a terminal
+bool g_bNonInteractive = false;
 
-enum class LogChannel
-{
-	GENERAL,
-	LIBCURL,
-	STEAM,
-	MARKET
-};
+volatile sig_atomic_t g_nExitSignal = 0;
 
-
-void Log(LogChannel channel, const char* format, ...)
-{
-	const char* logChannelNames[] =
-	{
-		"",
-		"libcurl",
-		"Steam",
-		"Market"
-	};
-
-	const time_t timestamp = time(nullptr);
-
-	// zh_CN.utf8 locale's time on linux looks like this 2022年10月18日 15时08分28秒
-	// so allocate some space
-	char dateTime[64];
-
-#ifdef _WIN32
-	// windows didn't support utf-8 codepages until recently, so map UTF-16 to UTF-8 instead
-	const size_t wideDatatimeLen = sizeof(dateTime);
-	wchar_t wideDatetime[wideDatatimeLen];
-	wcsftime(wideDatetime, wideDatatimeLen, L"%x %X", localtime(&timestamp));
-
-	if (!WideCharToMultiByte(CP_UTF8, 0, wideDatetime, -1, dateTime, sizeof(dateTime), NULL, NULL))
-		strcpy(dateTime, "timestamp UTF-16 to UTF-8 mapping failed");
-
-#else
-	strftime(dateTime, sizeof(dateTime), "%x %X", localtime(&timestamp));
-#endif // _WIN32
-
-	printf("[%s] ", dateTime);
-
-	if (g_pszLogAccountName)
-		printf("[%s] ", g_pszLogAccountName);
-
-	if (channel != LogChannel::GENERAL)
-		printf("[%s] ", logChannelNames[(size_t)channel]);
-
-	va_list args;
-	va_start(args, format);
-	vprintf(format, args);
-	va_end(args);
-}
+// set by SIGUSR1, the main loop prints the request statistics and clears it
+volatile sig_atomic_t g_bStatsDumpRequested = 0;
 
 #ifdef _WIN32
 void FlashCurrentWindow()
 {
+	if (g_bNonInteractive)
+		return;
+
 	static const HWND hWnd = GetConsoleWindow();
 	if (!hWnd) return;
 	FlashWindow(hWnd, TRUE);
@@ -109,6 +49,12 @@ void SetStdinEcho(bool enable)
 
 bool GetUserInputString(const char* msg, char* buf, size_t bufSz, size_t minLen = 1, bool echoStdin = true)
 {
+	if (g_bNonInteractive)
+	{
+		Log(LogChannel::GENERAL, "%s: input required, but running non-interactively\n", msg);
+		return false;
+	}
+
 	const size_t maxLen = bufSz - 1;
 
 	if (!echoStdin)
@@ -137,6 +83,9 @@ bool GetUserInputString(const char* msg, char* buf, size_t bufSz, size_t minLen
 		else
 			Log(LogChannel::GENERAL, "%s (%u bytes max): ", msg, maxLen);
 
+		// the prompt has to be on screen before we block on stdin
+		Logger::Flush();
+
 		size_t len = 0;
 
 #ifdef _WIN32
@@ -160,7 +109,7 @@ bool GetUserInputString(const char* msg, char* buf, size_t bufSz, size_t minLen
 		}
 
 		if (!echoStdin)
-			putchar('\n');
+			putsnn("\n");
 
 		if (minLen > len || len > maxLen)
 			continue;
@@ -279,6 +228,38 @@ bool ReadFile(const char* path, unsigned char** out, long* outSz)
 	return true;
 }
 
+// writes str as a quoted JSON string, returns the bytes written
+size_t WriteJsonString(FILE* file, const char* str)
+{
+	fputc('"', file);
+	size_t len = 2;
+
+	for (const char* iter = str; *iter; ++iter)
+	{
+		const unsigned char c = *iter;
+
+		if (c == '"' || c == '\\')
+		{
+			fputc('\\', file);
+			fputc(c, file);
+			len += 2;
+		}
+		else if (c < 0x20)
+		{
+			fprintf(file, "\\u%04x", c);
+			len += 6;
+		}
+		else
+		{
+			fputc(c, file);
+			++len;
+		}
+	}
+
+	fputc('"', file);
+	return len;
+}
+
 // get executable dir
 const char* GetExeDir()
 {
@@ -312,6 +293,9 @@ const char* GetExeDir()
 
 void Pause()
 {
+	if (g_bNonInteractive)
+		return;
+
 #ifdef _WIN32
 	// check if stdout isn't a terminal
 	if (!_isatty(_fileno(stdout)))
@@ -324,6 +308,7 @@ void Pause()
 		return;
 
 	putsnn("Press Enter to continue\n");
+	Logger::Flush();
 
 	wint_t c;
 	while ((c = getwchar()) != L'\n' && c != WEOF);
@@ -343,6 +328,14 @@ inline uint32_t byteswap32(uint32_t dw)
 	return res;
 }
 
+// memset for secrets, the stores can't be dropped as dead
+inline void SecureZero(void* dest, size_t size)
+{
+	volatile unsigned char* p = (volatile unsigned char*)dest;
+	while (size--)
+		*p++ = 0;
+}
+
 inline uint64_t byteswap64(uint64_t qw)
 {
 	uint64_t res;
@@ -361,6 +354,9 @@ inline uint64_t byteswap64(uint64_t qw)
 
 void ClearConsole()
 {
+	if (g_bNonInteractive)
+		return;
+
 #ifdef _WIN32
 	// is stdout a terminal
 	if (!_isatty(_fileno(stdout)))
@@ -403,4 +399,48 @@ void ClearConsole()
 	putsnn("\x1b[H\x1b[J\x1b[3J");
 
 #endif // _WIN32
+}
+
+void OnExitSignal(int sig)
+{
+	g_nExitSignal = sig;
+}
+
+void SetExitSignalHandlers()
+{
+	signal(SIGINT, OnExitSignal);
+	signal(SIGTERM, OnExitSignal);
+#ifndef _WIN32
+	signal(SIGHUP, OnExitSignal);
+#endif // !_WIN32
+}
+
+void OnStatsDumpSignal(int)
+{
+	g_bStatsDumpRequested = 1;
+}
+
+void SetStatsDumpSignalHandler()
+{
+#ifndef _WIN32
+	signal(SIGUSR1, OnStatsDumpSignal);
+#endif // !_WIN32
+}
+
+// returns false if interrupted by an exit signal
+bool SleepUnlessExiting(std::chrono::milliseconds duration)
+{
+	const auto step = 250ms;
+	const auto endTime = std::chrono::steady_clock::now() + duration;
+
+	while (!g_nExitSignal)
+	{
+		const auto curTime = std::chrono::steady_clock::now();
+		if (endTime <= curTime)
+			return true;
+
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(step, endTime - curTime));
+	}
+
+	return false;
 }
\ No newline at end of file
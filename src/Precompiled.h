@@ -7,11 +7,22 @@
 #include <cstring>
 #include <cstdarg>
 #include <cstdio>
+#include <csignal>
 #include <string>
 #include <vector>
+#include <array>
+#include <functional>
+#include <memory>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
 #include <filesystem>
 #include <unordered_set>
+#include <unordered_map>
+#include <deque>
+#include <list>
 
 #ifdef _WIN32
 
@@ -43,6 +54,9 @@
 #define _stat stat
 #define _fstat fstat
 #define _fileno fileno
+#define _read read
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
 
 #include <wolfssl/options.h>
 
@@ -59,6 +73,7 @@
 #include "wolfssl/wolfcrypt/hmac.h"
 #include "wolfssl/version.h"
 #include "curl/curl.h"
+#include "zlib.h"
 
 using namespace std::chrono_literals;
 
@@ -0,0 +1,424 @@
+#pragma once
+
+// --proxy-file spreads the accounts over a list of proxies, one [scheme://][username:password@]host[:port] per line.
+// an account sticks to its proxy so Steam and the market keep seeing it from one address, and only moves when
+// the proxy goes down. new accounts go to the proxy with the least load by measured latency,
+// every proxy is probed in the background so a dead one is noticed between its accounts' turns
+namespace ProxyPool
+{
+	class CProxy
+	{
+	public:
+		std::string		url;
+		std::string		label;					// host and port without the credentials, for the log and metrics
+
+		bool			up = true;
+		int				failureCount = 0;		// consecutive proxy errors of requests
+		double			latencyMs = 0;			// moving average of probes and requests, 0 until measured
+		size_t			accountCount = 0;
+
+		std::chrono::steady_clock::time_point	nextProbeTime;
+	};
+
+	const int failureThreshold = 3;
+	const auto probeInterval = 1min;
+	const double latencyWeight = 0.2;			// of a new sample in the moving average
+	const double latencyUnmeasuredMs = 1000;	// assumed for a proxy that hasn't been measured yet
+
+	// answers without a session, any HTTP response means the proxy works
+	const char probeUrl[] = "https://api.steampowered.com/ISteamWebAPIUtil/GetServerInfo/v1/";
+
+	std::vector<CProxy>		proxies;
+	std::mutex				mutex;
+
+	// account name to index in proxies
+	std::unordered_map<std::string, size_t>		assignments;
+
+	// --proxy, used when there's no list and outside of an account's turn
+	const char*				defaultProxy = nullptr;
+
+	// proxy of the account this thread is running, -1 if none
+	thread_local int		currentProxy = -1;
+
+	std::atomic<bool>		enabled(false);
+	std::atomic<bool>		stopping(false);
+	std::thread				thread;
+	std::condition_variable	stopCondVar;
+
+	bool IsEnabled()
+	{
+		return enabled;
+	}
+
+	std::string GetLabel(const char* url)
+	{
+		const char* scheme = strstr(url, "://");
+		const char* host = scheme ? (scheme + sizeof("://") - 1) : url;
+
+		const char* credentialsEnd = strrchr(host, '@');
+		if (credentialsEnd)
+			host = credentialsEnd + 1;
+
+		return std::string(host, strcspn(host, "/"));
+	}
+
+	bool Load(const char* path)
+	{
+		Log(LogChannel::LIBCURL, "Loading the proxy list...");
+
+		FILE* file = u8fopen(path, "rb");
+		if (!file)
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		char line[1024];
+
+		while (fgets(line, sizeof(line), file))
+		{
+			char* start = line;
+			while (*start == ' ' || *start == '\t')
+				++start;
+
+			size_t len = strcspn(start, "\r\n");
+			while (len && (start[len - 1] == ' ' || start[len - 1] == '\t'))
+				--len;
+
+			if (!len || start[0] == '#')
+				continue;
+
+			start[len] = '\0';
+
+			proxies.emplace_back();
+			proxies.back().url = start;
+			proxies.back().label = GetLabel(start);
+		}
+
+		fclose(file);
+		memset(line, 0, sizeof(line));
+
+		if (proxies.empty())
+		{
+			putsnn("fail, no proxies in the file\n");
+			return false;
+		}
+
+		LogAppend("ok, %zu proxies\n", proxies.size());
+		return true;
+	}
+
+	void UpdateLatency(CProxy* proxy, double sampleMs)
+	{
+		proxy->latencyMs = proxy->latencyMs ?
+			((1 - latencyWeight) * proxy->latencyMs + latencyWeight * sampleMs) : sampleMs;
+	}
+
+	void SetUp(CProxy* proxy, bool up)
+	{
+		if (proxy->up == up)
+			return;
+
+		proxy->up = up;
+		proxy->failureCount = 0;
+
+		Log(LogChannel::LIBCURL, up ? "Proxy %s is back up\n" : "Proxy %s is down\n", proxy->label.c_str());
+	}
+
+	// the up proxy with the least accounts per request per second it can carry, -1 if all are down.
+	// an account's requests go one after another, so that's the inverse of the measured latency
+	int PickProxy()
+	{
+		int best = -1;
+		double bestScore = 0;
+
+		for (size_t i = 0; i < proxies.size(); ++i)
+		{
+			const CProxy& proxy = proxies[i];
+			if (!proxy.up)
+				continue;
+
+			const double latencyMs = proxy.latencyMs ? proxy.latencyMs : latencyUnmeasuredMs;
+			const double score = (proxy.accountCount + 1) * latencyMs;
+
+			if (best < 0 || score < bestScore)
+			{
+				best = (int)i;
+				bestScore = score;
+			}
+		}
+
+		return best;
+	}
+
+	// the account's proxy, assigning one the first time or when its proxy is down
+	const char* Assign(const char* accountName)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto iter = assignments.find(accountName);
+
+		if (iter != assignments.end() && proxies[iter->second].up)
+		{
+			currentProxy = (int)iter->second;
+			return proxies[currentProxy].url.c_str();
+		}
+
+		const int picked = PickProxy();
+
+		// all down, stay where it is rather than pile everyone on one
+		if (picked < 0)
+		{
+			currentProxy = (iter != assignments.end()) ? (int)iter->second : 0;
+
+			if (iter == assignments.end())
+			{
+				assignments.emplace(accountName, 0);
+				++proxies[0].accountCount;
+			}
+
+			return proxies[currentProxy].url.c_str();
+		}
+
+		if (iter != assignments.end())
+		{
+			Log(LogChannel::LIBCURL, "Proxy %s is down, moving to %s\n",
+				proxies[iter->second].label.c_str(), proxies[picked].label.c_str());
+
+			--proxies[iter->second].accountCount;
+			iter->second = picked;
+		}
+		else
+			assignments.emplace(accountName, picked);
+
+		++proxies[picked].accountCount;
+
+		currentProxy = picked;
+		return proxies[currentProxy].url.c_str();
+	}
+
+	void Unassign(const char* accountName)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto iter = assignments.find(accountName);
+		if (iter == assignments.end())
+			return;
+
+		--proxies[iter->second].accountCount;
+		assignments.erase(iter);
+	}
+
+	// sends the requests of this thread through the account's proxy until it goes out of scope
+	class CAccountScope
+	{
+		CURL*		curl;
+		const char*	proxy;
+
+	public:
+		CAccountScope(CURL* curlHandle, const char* accountName) : curl(curlHandle), proxy(defaultProxy)
+		{
+			if (proxies.empty())
+				return;
+
+			proxy = Assign(accountName);
+			curl_easy_setopt(curl, CURLOPT_PROXY, proxy);
+		}
+
+		~CAccountScope()
+		{
+			if (currentProxy < 0)
+				return;
+
+			currentProxy = -1;
+			curl_easy_setopt(curl, CURLOPT_PROXY, defaultProxy);
+		}
+
+		CAccountScope(const CAccountScope&) = delete;
+		CAccountScope(const CAccountScope&&) = delete;
+
+		// for the market's own requests on the account's behalf
+		const char* GetProxy() const
+		{
+			return proxy;
+		}
+	};
+
+	// the proxy itself failed rather than the server behind it. a slow or failing origin, or one the proxy
+	// can't reach, is left to Backoff, otherwise a Steam outage would take every proxy down at once
+	bool IsProxyError(CURL* curl, CURLcode respCode)
+	{
+		long connectCode = 0;
+		curl_easy_getinfo(curl, CURLINFO_HTTP_CONNECTCODE, &connectCode);
+
+		if (connectCode == 407 || respCode == CURLE_COULDNT_RESOLVE_PROXY || respCode == CURLE_COULDNT_CONNECT)
+			return true;
+
+#if LIBCURL_VERSION_NUM >= CURL_VERSION_BITS(7, 73, 0)
+		if (respCode == CURLE_PROXY)
+			return true;
+#endif // LIBCURL_VERSION_NUM >= 7.73.0
+
+		// timed out before the connection to the proxy was up
+		if (respCode == CURLE_OPERATION_TIMEDOUT)
+		{
+			curl_off_t connectTimeUs = 0;
+			curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connectTimeUs);
+
+			return !connectTimeUs;
+		}
+
+		return false;
+	}
+
+	// after every request of an account's turn
+	void Record(CURL* curl, CURLcode respCode)
+	{
+		if (currentProxy < 0)
+			return;
+
+		const bool proxyError = IsProxyError(curl, respCode);
+
+		curl_off_t totalTimeUs = 0;
+		curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalTimeUs);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		CProxy* proxy = &proxies[currentProxy];
+
+		if (proxyError)
+		{
+			if (failureThreshold <= ++proxy->failureCount)
+				SetUp(proxy, false);
+
+			return;
+		}
+
+		proxy->failureCount = 0;
+
+		// only round trips that got an answer say how fast the proxy is
+		if (respCode == CURLE_OK || respCode == CURLE_HTTP_RETURNED_ERROR)
+			UpdateLatency(proxy, totalTimeUs / 1000.0);
+	}
+
+	// false if the proxy failed, outLatencyMs is left 0 when there was no answer to time, e.g. Steam is down
+	bool Probe(CURL* curl, const char* proxyUrl, double* outLatencyMs)
+	{
+		Curl::CResponse response;
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+		curl_easy_setopt(curl, CURLOPT_PROXY, proxyUrl);
+		Curl::SetUrl(curl, probeUrl);
+		curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+		Resolver::Apply(curl);
+
+		const CURLcode respCode = ::curl_easy_perform(curl);
+
+		if (IsProxyError(curl, respCode))
+			return false;
+
+		if (respCode == CURLE_OK || respCode == CURLE_HTTP_RETURNED_ERROR)
+		{
+			curl_off_t totalTimeUs = 0;
+			curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalTimeUs);
+
+			*outLatencyMs = totalTimeUs / 1000.0;
+		}
+
+		return true;
+	}
+
+	// probes the proxies that are due one at a time, so a dead proxy's timeout doesn't delay the others much
+	void ThreadMain(CURL* curl)
+	{
+		std::string url;
+
+		while (!stopping)
+		{
+			const auto curTime = std::chrono::steady_clock::now();
+			auto nextProbeTime = curTime + probeInterval;
+
+			for (size_t i = 0; i < proxies.size() && !stopping; ++i)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					if (curTime < proxies[i].nextProbeTime)
+					{
+						nextProbeTime = std::min(nextProbeTime, proxies[i].nextProbeTime);
+						continue;
+					}
+
+					proxies[i].nextProbeTime = curTime + probeInterval;
+					url = proxies[i].url;
+				}
+
+				double latencyMs = 0;
+				const bool up = Probe(curl, url.c_str(), &latencyMs);
+
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (latencyMs)
+					UpdateLatency(&proxies[i], latencyMs);
+
+				SetUp(&proxies[i], up);
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			stopCondVar.wait_until(lock, nextProbeTime, []() { return (bool)stopping; });
+		}
+
+		memset(&url[0], 0, url.size());
+	}
+
+	// on its own copy of the handle, without the session cookies
+	bool Start(CURL* curl)
+	{
+		Log(LogChannel::LIBCURL, "Starting proxy health probes...");
+
+		CURL* probeCurl = curl_easy_duphandle(curl);
+		if (!probeCurl)
+		{
+			putsnn("handle duplication failed\n");
+			return false;
+		}
+
+		curl_easy_setopt(probeCurl, CURLOPT_COOKIELIST, "ALL");
+		curl_easy_setopt(probeCurl, CURLOPT_VERBOSE, 0L);
+
+		stopping = false;
+		thread = std::thread([probeCurl]()
+			{
+				ThreadMain(probeCurl);
+				curl_easy_cleanup(probeCurl);
+			});
+		enabled = true;
+
+		putsnn("ok\n");
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!enabled)
+			return;
+
+		enabled = false;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		stopCondVar.notify_all();
+		thread.join();
+	}
+
+	template <typename Func>
+	void ForEachProxy(Func func)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (const auto& proxy : proxies)
+			func(proxy);
+	}
+}
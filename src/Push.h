@@ -0,0 +1,459 @@
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif // _WIN32
+
+// --push keeps a websocket to the market open per account and polls the account's markets as soon as the market
+// reports a new, sold, bought or changed item, instead of waiting for the next scheduled poll.
+// the feed: get a token with get-ws-auth, connect to Market::wsUrl, send the token, send "ping" at least every minute.
+// the scheduled polls stay as the safety net while a socket is down or a notification is missed
+namespace Push
+{
+	class CSubscription
+	{
+	public:
+		std::string			name;				// account name, for the log
+		std::string			apiKey;
+		std::atomic<bool>	connected{ false };
+		std::atomic<bool>	pending{ false };	// something happened since the account last polled
+
+		bool IsPending() const
+		{
+			return pending;
+		}
+
+		// true once per batch of notifications
+		bool TakePending()
+		{
+			return pending.exchange(false);
+		}
+	};
+
+	const auto pingInterval = 30s;
+	const auto reconnectIntervalMin = 5s;
+	const auto reconnectIntervalMax = 5min;
+	const size_t maxMessageSz = 1024 * 1024;
+
+	// message types about the account's items, each followed by the market's suffix, e.g. itemstatus_go
+	const char* itemMessageTypes[] =
+	{
+		"additem",
+		"itemout",
+		"itemstatus",
+	};
+
+	std::atomic<bool>	enabled(false);
+	std::atomic<bool>	stopping(false);
+	std::thread			thread;
+
+	// the thread's own copy of the main handle, curl handles can't be shared between threads
+	CURL*				httpCurl = nullptr;
+
+	// picked up by the thread, which drops a subscription once its account no longer holds it
+	std::mutex									subscribeMutex;
+	std::vector<std::shared_ptr<CSubscription>>	newSubscriptions;
+
+	bool IsEnabled()
+	{
+		return enabled;
+	}
+
+	std::shared_ptr<CSubscription> Subscribe(const char* name, const char* apiKey)
+	{
+		auto subscription = std::make_shared<CSubscription>();
+		subscription->name = name;
+		subscription->apiKey = apiKey;
+
+		std::lock_guard<std::mutex> lock(subscribeMutex);
+		newSubscriptions.emplace_back(subscription);
+
+		return subscription;
+	}
+
+#if LIBCURL_VERSION_NUM >= CURL_VERSION_BITS(7, 86, 0)
+	class CConnection
+	{
+	public:
+		std::shared_ptr<CSubscription>			subscription;
+		CURL*									curl = nullptr;
+		std::string								message;	// frames of the message being received
+		std::chrono::steady_clock::time_point	nextConnectTime;
+		std::chrono::steady_clock::time_point	nextPingTime;
+		std::chrono::steady_clock::duration		reconnectInterval = reconnectIntervalMin;
+
+		// connects on its own thread so a slow or dead handshake doesn't hold up the other accounts
+		std::thread								connectThread;
+		std::atomic<bool>						connectDone{ false };
+		CURL*									connectedCurl = nullptr;	// set before connectDone, nullptr if failed
+	};
+
+	bool SendText(CURL* curl, const char* text)
+	{
+		size_t sent;
+		return (curl_ws_send(curl, text, strlen(text), &sent, 0, CURLWS_TEXT) == CURLE_OK);
+	}
+
+	// the frame info became const in later libcurl versions, takes curl_ws_recv to compile against either
+	template <typename Frame>
+	CURLcode RecvFrame(CURLcode (*recv)(CURL*, void*, size_t, size_t*, Frame**),
+		CURL* curl, char* buf, size_t bufSz, size_t* outReceived, const curl_ws_frame** outMeta)
+	{
+		Frame* meta = nullptr;
+		const CURLcode respCode = recv(curl, buf, bufSz, outReceived, &meta);
+
+		*outMeta = meta;
+		return respCode;
+	}
+
+	// retries with exponential backoff unless the account is gone
+	void Disconnect(CConnection* connection, bool retry)
+	{
+		if (connection->curl)
+		{
+			curl_easy_cleanup(connection->curl);
+			connection->curl = nullptr;
+		}
+
+		connection->subscription->connected = false;
+		connection->message.clear();
+
+		if (retry)
+		{
+			connection->nextConnectTime = std::chrono::steady_clock::now() + connection->reconnectInterval;
+			connection->reconnectInterval = std::min<std::chrono::steady_clock::duration>(
+				connection->reconnectInterval * 2, reconnectIntervalMax);
+		}
+	}
+
+	// on the connection's thread, with a copy of httpCurl it owns from here on
+	bool Connect(CSubscription* subscription, CURL* curl)
+	{
+		CLoggingContext loggingContext(subscription->name.c_str());
+
+		// the market sees the token request and the socket from the same address as the account's other requests
+		ProxyPool::CAccountScope proxyScope(curl, subscription->name.c_str());
+		SourceAddress::CAccountScope sourceAddressScope(curl, subscription->name.c_str());
+
+		char token[Market::wsAuthBufSz];
+
+		if (!Market::GetWsAuth(curl, subscription->apiKey.c_str(), token))
+		{
+			curl_easy_cleanup(curl);
+			Log(LogChannel::MARKET, "Getting the push channel token failed\n");
+			return false;
+		}
+
+		// no --record debug callback, it would collect the frames forever
+		curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+		curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 2L);
+		Curl::SetWebSocketUrl(curl, Market::wsUrl);
+		Resolver::Apply(curl);
+
+		const CURLcode respCode = ::curl_easy_perform(curl);
+
+		if (respCode != CURLE_OK || !SendText(curl, token))
+		{
+			memset(token, 0, sizeof(token));
+			curl_easy_cleanup(curl);
+			Log(LogChannel::MARKET, "Connecting the push channel failed (libcurl code %d)\n", respCode);
+			return false;
+		}
+
+		memset(token, 0, sizeof(token));
+		return true;
+	}
+
+	bool StartConnect(CConnection* connection)
+	{
+		CURL* curl = curl_easy_duphandle(httpCurl);
+		if (!curl)
+			return false;
+
+		connection->connectedCurl = nullptr;
+		connection->connectDone = false;
+		connection->connectThread = std::thread([connection, curl]()
+			{
+				connection->connectedCurl = Connect(connection->subscription.get(), curl) ? curl : nullptr;
+				connection->connectDone = true;
+			});
+
+		return true;
+	}
+
+	// on the poll thread once the connect thread is done
+	void FinishConnect(CConnection* connection)
+	{
+		connection->connectThread.join();
+
+		if (!connection->connectedCurl)
+		{
+			Disconnect(connection, true);
+			return;
+		}
+
+		connection->curl = connection->connectedCurl;
+		connection->connectedCurl = nullptr;
+		connection->nextPingTime = std::chrono::steady_clock::now() + pingInterval;
+		connection->reconnectInterval = reconnectIntervalMin;
+
+		// whatever happened while disconnected was never pushed
+		connection->subscription->connected = true;
+		connection->subscription->pending = true;
+
+		Log(LogChannel::MARKET, "Push channel connected\n");
+	}
+
+	void HandleMessage(CSubscription* subscription, const std::string& message)
+	{
+		rapidjson::Document parsed;
+		parsed.Parse(message.c_str(), message.size());
+
+		// e.g. the "pong"s
+		if (parsed.HasParseError() || !parsed.IsObject())
+			return;
+
+		const auto iterType = parsed.FindMember("type");
+		if (iterType == parsed.MemberEnd() || !iterType->value.IsString())
+			return;
+
+		const char* type = iterType->value.GetString();
+
+		for (const char* itemMessageType : itemMessageTypes)
+		{
+			if (!strncmp(type, itemMessageType, strlen(itemMessageType)))
+			{
+				subscription->pending = true;
+				return;
+			}
+		}
+	}
+
+	// reads everything that arrived, false once the connection is gone
+	bool Receive(CConnection* connection)
+	{
+		char buf[4096];
+
+		while (true)
+		{
+			size_t received = 0;
+			const curl_ws_frame* meta = nullptr;
+
+			const CURLcode respCode = RecvFrame(curl_ws_recv, connection->curl, buf, sizeof(buf), &received, &meta);
+
+			if (respCode == CURLE_AGAIN)
+				return true;
+
+			if (respCode != CURLE_OK || (meta->flags & CURLWS_CLOSE))
+				return false;
+
+			// libcurl answers the pings itself
+			if (!(meta->flags & (CURLWS_TEXT | CURLWS_BINARY)))
+				continue;
+
+			if (maxMessageSz < connection->message.size() + received)
+				return false;
+
+			connection->message.append(buf, received);
+
+			// more of this frame, or more frames of this message
+			if (meta->bytesleft || (meta->flags & CURLWS_CONT))
+				continue;
+
+			HandleMessage(connection->subscription.get(), connection->message);
+			connection->message.clear();
+		}
+	}
+
+	void ThreadMain()
+	{
+		// the connect threads hold pointers to their connection
+		std::list<CConnection> connections;
+
+#ifdef _WIN32
+		std::vector<WSAPOLLFD> pfds;
+#else
+		std::vector<pollfd> pfds;
+#endif // _WIN32
+		std::vector<CConnection*> polled;
+
+		while (!stopping)
+		{
+			{
+				std::lock_guard<std::mutex> lock(subscribeMutex);
+
+				for (auto& subscription : newSubscriptions)
+				{
+					connections.emplace_back();
+					connections.back().subscription = std::move(subscription);
+				}
+
+				newSubscriptions.clear();
+			}
+
+			for (auto iter = connections.begin(); iter != connections.end() && !stopping; )
+			{
+				CConnection* connection = &(*iter);
+
+				// still connecting
+				if (connection->connectThread.joinable() && !connection->connectDone)
+				{
+					++iter;
+					continue;
+				}
+
+				CLoggingContext loggingContext(connection->subscription->name.c_str());
+
+				if (connection->connectThread.joinable())
+					FinishConnect(connection);
+
+				// the account was removed
+				if (connection->subscription.use_count() == 1)
+				{
+					Disconnect(connection, false);
+					iter = connections.erase(iter);
+					continue;
+				}
+
+				++iter;
+
+				const auto curTime = std::chrono::steady_clock::now();
+
+				if (!connection->curl)
+				{
+					if (connection->nextConnectTime <= curTime && !StartConnect(connection))
+						Disconnect(connection, true);
+				}
+				else if (connection->nextPingTime <= curTime)
+				{
+					connection->nextPingTime = curTime + pingInterval;
+
+					if (!SendText(connection->curl, "ping"))
+					{
+						Log(LogChannel::MARKET, "Push channel lost, reconnecting\n");
+						Disconnect(connection, true);
+					}
+				}
+			}
+
+			pfds.clear();
+			polled.clear();
+
+			for (auto& connection : connections)
+			{
+				if (!connection.curl)
+					continue;
+
+				curl_socket_t sock = CURL_SOCKET_BAD;
+				if (curl_easy_getinfo(connection.curl, CURLINFO_ACTIVESOCKET, &sock) != CURLE_OK || sock == CURL_SOCKET_BAD)
+					continue;
+
+				pfds.emplace_back();
+				pfds.back().fd = sock;
+				pfds.back().events = POLLIN;
+				pfds.back().revents = 0;
+				polled.emplace_back(&connection);
+			}
+
+			if (pfds.empty())
+			{
+				std::this_thread::sleep_for(250ms);
+				continue;
+			}
+
+#ifdef _WIN32
+			if (WSAPoll(pfds.data(), (ULONG)pfds.size(), 250) <= 0)
+				continue;
+#else
+			if (poll(pfds.data(), pfds.size(), 250) <= 0)
+				continue;
+#endif // _WIN32
+
+			for (size_t i = 0; i < pfds.size(); ++i)
+			{
+				if (!pfds[i].revents)
+					continue;
+
+				CConnection* connection = polled[i];
+				CLoggingContext loggingContext(connection->subscription->name.c_str());
+
+				if (!Receive(connection))
+				{
+					Log(LogChannel::MARKET, "Push channel lost, reconnecting\n");
+					Disconnect(connection, true);
+				}
+			}
+		}
+
+		for (auto& connection : connections)
+		{
+			if (connection.connectThread.joinable())
+			{
+				connection.connectThread.join();
+
+				if (connection.connectedCurl)
+					curl_easy_cleanup(connection.connectedCurl);
+			}
+
+			Disconnect(&connection, false);
+		}
+	}
+#endif // LIBCURL_VERSION_NUM >= 7.86.0
+
+	bool Start(CURL* curl)
+	{
+		Log(LogChannel::MARKET, "Starting the push channel...");
+
+#if LIBCURL_VERSION_NUM >= CURL_VERSION_BITS(7, 86, 0)
+		// websockets are opt-in when building libcurl before 8.11.0
+		bool hasWebSockets = false;
+
+		const curl_version_info_data* versionInfo = curl_version_info(CURLVERSION_NOW);
+		for (const char* const* protocol = versionInfo->protocols; *protocol; ++protocol)
+		{
+			if (!strcmp(*protocol, "ws"))
+				hasWebSockets = true;
+		}
+
+		if (!hasWebSockets)
+		{
+			putsnn("fail, libcurl was built without websocket support\n");
+			return false;
+		}
+
+		httpCurl = curl_easy_duphandle(curl);
+		if (!httpCurl)
+		{
+			putsnn("handle duplication failed\n");
+			return false;
+		}
+
+		stopping = false;
+		thread = std::thread(ThreadMain);
+		enabled = true;
+
+		putsnn("ok\n");
+		return true;
+#else
+		putsnn("fail, libcurl 7.86.0 or newer is required\n");
+		return false;
+#endif // LIBCURL_VERSION_NUM >= 7.86.0
+	}
+
+	// before libcurl is cleaned up
+	void Stop()
+	{
+		if (!enabled)
+			return;
+
+		enabled = false;
+		stopping = true;
+		thread.join();
+
+		curl_easy_cleanup(httpCurl);
+		httpCurl = nullptr;
+	}
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+namespace RateLimiter
+{
+	// most urgent first
+	enum class Priority
+	{
+		DELIVERY,		// requesting, sending, accepting and reporting trades
+		CONFIRMATION,	// mobile confirmations
+		CANCELLATION,	// listing and cancelling expired offers
+		POLLING,		// market item status
+		HOUSEKEEPING,	// sessions, pings, time sync and everything else
+
+		COUNT
+	};
+
+	// requests made outside of a scope are housekeeping
+	thread_local Priority currentPriority = Priority::HOUSEKEEPING;
+
+	// sets the priority of the requests this thread makes until it goes out of scope, scopes nest
+	class CPriorityScope
+	{
+		Priority prevPriority;
+
+	public:
+		CPriorityScope(Priority priority) : prevPriority(currentPriority)
+		{
+			currentPriority = priority;
+		}
+
+		~CPriorityScope()
+		{
+			currentPriority = prevPriority;
+		}
+
+		CPriorityScope(const CPriorityScope&) = delete;
+		CPriorityScope(const CPriorityScope&&) = delete;
+	};
+}
+
+// spaces the requests to one service by at least an interval, the requests waiting for a slot get it strictly
+// by priority and then in arrival order, so a delivery never queues behind polls or housekeeping of other threads
+class CRateLimiter
+{
+	std::string				name;	// for the trace and the shared table
+
+	// other instances on the host reserve times here too, nullptr without --shared-rate-limit
+	SharedRateLimit::CSlot*	sharedSlot;
+
+	std::mutex				mutex;
+	std::condition_variable	condVar;
+
+	Clock::time_point		nextRequestTime;
+	uint64_t				nextTicket = 0;
+
+	// tickets of the waiting requests per priority
+	std::array<std::deque<uint64_t>, (size_t)RateLimiter::Priority::COUNT>	waiting;
+
+	bool IsNext(RateLimiter::Priority priority, uint64_t ticket) const
+	{
+		for (int higher = 0; higher < (int)priority; ++higher)
+		{
+			if (!waiting[higher].empty())
+				return false;
+		}
+
+		return (waiting[(int)priority].front() == ticket);
+	}
+
+	bool IsAnyWaiting() const
+	{
+		for (const auto& queue : waiting)
+		{
+			if (!queue.empty())
+				return true;
+		}
+
+		return false;
+	}
+
+	// virtual time only moves when the next in line sleeps, so everyone else waits on the condition variable
+	void WaitForTurn(std::unique_lock<std::mutex>* lock, RateLimiter::Priority priority, std::chrono::microseconds interval)
+	{
+		const uint64_t ticket = nextTicket++;
+		waiting[(int)priority].push_back(ticket);
+
+		while (true)
+		{
+			if (!IsNext(priority, ticket))
+			{
+				condVar.wait(*lock);
+				continue;
+			}
+
+			const auto curTime = Clock::Now();
+
+			if (nextRequestTime <= curTime)
+			{
+				waiting[(int)priority].pop_front();
+				nextRequestTime = curTime + interval;
+				break;
+			}
+
+			// a more urgent request arriving meanwhile takes the slot instead
+			const auto requestTime = nextRequestTime;
+
+			lock->unlock();
+			Clock::SleepUntil(requestTime);
+			lock->lock();
+		}
+
+		// the next in line has changed
+		condVar.notify_all();
+	}
+
+public:
+	CRateLimiter(const std::string& limiterName) : name(limiterName), sharedSlot(SharedRateLimit::GetSlot(limiterName))
+	{
+
+	}
+
+	CRateLimiter(const CRateLimiter&) = delete;
+	CRateLimiter(const CRateLimiter&&) = delete;
+
+	// blocks until the calling thread's request may go, returns how long it waited
+	std::chrono::microseconds Wait(std::chrono::microseconds interval)
+	{
+		const RateLimiter::Priority priority = RateLimiter::currentPriority;
+		const auto startTime = Clock::Now();
+
+		bool waited = false;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if (!IsAnyWaiting() && nextRequestTime <= startTime)
+				nextRequestTime = startTime + interval;
+			else
+			{
+				Trace::CTraceSpan span("ratelimit", "%s rate limit", name.c_str());
+				WaitForTurn(&lock, priority, interval);
+				waited = true;
+			}
+		}
+
+		// the priorities only order the requests of this instance
+		if (sharedSlot)
+		{
+			const auto sharedRequestTime = SharedRateLimit::Reserve(sharedSlot, interval);
+
+			if (Clock::Now() < sharedRequestTime)
+			{
+				Trace::CTraceSpan span("ratelimit", "%s shared rate limit", name.c_str());
+				Clock::SleepUntil(sharedRequestTime);
+				waited = true;
+			}
+		}
+
+		if (!waited)
+			return 0us;
+
+		return std::chrono::duration_cast<std::chrono::microseconds>(Clock::Now() - startTime);
+	}
+};
+
+// one limiter per route a service's requests leave by, so requests from different source addresses or proxies
+// don't share a limit, "" is the default route
+class CRateLimiterSet
+{
+	std::string		name;
+
+	std::mutex		mutex;
+	std::unordered_map<std::string, std::unique_ptr<CRateLimiter>>	limiters;
+
+public:
+	CRateLimiterSet(const char* setName) : name(setName)
+	{
+
+	}
+
+	CRateLimiterSet(const CRateLimiterSet&) = delete;
+	CRateLimiterSet(const CRateLimiterSet&&) = delete;
+
+	std::string GetLimiterName(const char* route) const
+	{
+		return route[0] ? (name + " via " + route) : name;
+	}
+
+	CRateLimiter* Get(const char* route)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto& limiter = limiters[route];
+		if (!limiter)
+			limiter = std::make_unique<CRateLimiter>(GetLimiterName(route));
+
+		return limiter.get();
+	}
+};
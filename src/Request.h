@@ -0,0 +1,63 @@
+#pragma once
+
+// the path every Market and Steam request takes, after the modules it reports to
+namespace Curl
+{
+	CURLcode PerformOnce(CURL* curl, CRateLimiterSet* rateLimiters, std::chrono::microseconds interval,
+		const std::string& host, const char* route, int market)
+	{
+		std::chrono::microseconds backoffWait;
+
+		requestSkipped = !Backoff::BeforeRequest(host, &backoffWait);
+		if (requestSkipped)
+			return CURLE_COULDNT_CONNECT;
+
+		const auto rateLimitWait = backoffWait + rateLimiters->Get(route)->Wait(interval);
+
+		Trace::CTraceSpan span("http", "request");
+
+		Resolver::Apply(curl);
+		Capture::BeginRequest();
+
+		const CURLcode respCode = ::curl_easy_perform(curl);
+
+		Capture::EndRequest(curl, respCode);
+		Backoff::AfterRequest(host, curl, respCode, interval);
+		ProxyPool::Record(curl, respCode);
+
+		char endpoint[endpointLabelBufSz];
+		GetEndpointLabel(curl, endpoint);
+
+		span.SetName(endpoint);
+
+		Latency::Record(curl, endpoint, respCode, rateLimitWait);
+
+		if (respCode != CURLE_OK)
+			Events::EmitRequestFailed(curl, endpoint, respCode, market);
+
+		return respCode;
+	}
+
+	// requests that are safe to repeat get another attempt when the first one times out or loses the connection.
+	// market is -1 if the request isn't market specific
+	CURLcode Perform(CURL* curl, CRateLimiterSet* rateLimiters, std::chrono::microseconds interval, int market = -1)
+	{
+		// hosts back off per route since their limits are per IP
+		const char* route = SourceAddress::GetRoute();
+		const std::string host = route[0] ? (requestHost + " via " + route) : requestHost;
+		const CTimeoutPolicy* policy = requestPolicy;
+
+		for (int attempt = 1; ; ++attempt)
+		{
+			CResponse::writing = nullptr;
+
+			const CURLcode respCode = PerformOnce(curl, rateLimiters, interval, host, route, market);
+
+			if (respCode == CURLE_OK || requestSkipped || policy->attempts <= attempt || !IsRetryable(respCode))
+				return respCode;
+
+			if (CResponse::writing)
+				CResponse::writing->Empty();
+		}
+	}
+}
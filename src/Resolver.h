@@ -0,0 +1,266 @@
+#pragma once
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#endif // _WIN32
+
+// --pre-resolve resolves the Market and Steam hosts in the background and hands the addresses to libcurl with
+// CURLOPT_RESOLVE, so no request waits for DNS and a resolver outage only means the addresses stop updating.
+// the system resolver doesn't say how long an answer lives, so every host is refreshed well within common TTLs
+namespace Resolver
+{
+	// the hosts of Market::marketBaseUrls and Market::wsUrl, and every Steam host the client talks to
+	const char* hosts[] =
+	{
+		"market.csgo.com",
+		"market.dota2.net",
+		"tf2.tm",
+		"rust.tm",
+		"gifts.tm",
+		"wsn.dota2.net",
+		"steamcommunity.com",
+		"api.steampowered.com",
+		"login.steampowered.com",
+	};
+
+	const int port = 443;
+	const auto refreshInterval = 1min;
+	const auto retryInterval = 10s;
+
+	std::mutex					mutex;
+	std::string					addresses[std::size(hosts)];	// comma separated, sorted, empty until resolved
+
+	// only touched by the refreshing thread
+	std::chrono::steady_clock::time_point	nextResolveTimes[std::size(hosts)];
+
+	// bumped whenever the addresses change so every thread passes them to its handles again
+	std::atomic<uint64_t>		generation(0);
+
+	std::atomic<bool>			enabled(false);
+	std::atomic<bool>			stopping(false);
+	std::thread					thread;
+	std::condition_variable		stopCondVar;
+
+	// the list the last handle of this thread got, libcurl reads it at the handle's next request.
+	// freed when the thread exits, e.g. a push channel's connect thread
+	class CThreadList
+	{
+	public:
+		curl_slist*	list = nullptr;
+
+		~CThreadList()
+		{
+			curl_slist_free_all(list);
+		}
+	};
+
+	thread_local CThreadList	threadList;
+	thread_local uint64_t		listGeneration = 0;
+	thread_local CURL*			appliedCurl = nullptr;
+	thread_local uint64_t		appliedGeneration = 0;
+
+	bool IsEnabled()
+	{
+		return enabled;
+	}
+
+	// IPv4 only like the requests, false if the host didn't resolve
+	bool Resolve(const char* host, std::string* out)
+	{
+		addrinfo hints = {};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* results = nullptr;
+		if (getaddrinfo(host, nullptr, &hints, &results) || !results)
+			return false;
+
+		std::vector<std::string> found;
+
+		for (const addrinfo* result = results; result; result = result->ai_next)
+		{
+			char address[INET_ADDRSTRLEN];
+
+			if (!inet_ntop(AF_INET, &((const sockaddr_in*)result->ai_addr)->sin_addr, address, sizeof(address)))
+				continue;
+
+			if (std::find(found.begin(), found.end(), address) == found.end())
+				found.emplace_back(address);
+		}
+
+		freeaddrinfo(results);
+
+		if (found.empty())
+			return false;
+
+		// the order the resolver returns them in changes between calls, the set rarely does
+		std::sort(found.begin(), found.end());
+
+		out->clear();
+
+		for (const auto& address : found)
+		{
+			if (!out->empty())
+				out->push_back(',');
+
+			out->append(address);
+		}
+
+		return true;
+	}
+
+	// resolves every host that's due, returns when the next one is
+	std::chrono::steady_clock::time_point Refresh()
+	{
+		auto nextRefreshTime = std::chrono::steady_clock::now() + refreshInterval;
+
+		for (size_t i = 0; i < std::size(hosts) && !stopping; ++i)
+		{
+			const auto curTime = std::chrono::steady_clock::now();
+
+			if (curTime < nextResolveTimes[i])
+			{
+				nextRefreshTime = std::min(nextRefreshTime, nextResolveTimes[i]);
+				continue;
+			}
+
+			std::string resolved;
+			const bool ok = Resolve(hosts[i], &resolved);
+
+			// keep what the host last resolved to
+			nextResolveTimes[i] = curTime + (ok ? refreshInterval : retryInterval);
+			nextRefreshTime = std::min(nextRefreshTime, nextResolveTimes[i]);
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (!ok)
+			{
+				// Start reports the ones that never resolved
+				if (enabled && addresses[i].empty())
+					Log(LogChannel::LIBCURL, "Pre-resolving %s failed, retrying in %lld s\n", hosts[i],
+						(long long)std::chrono::duration_cast<std::chrono::seconds>(retryInterval).count());
+
+				continue;
+			}
+
+			if (addresses[i] != resolved)
+			{
+				addresses[i] = resolved;
+				++generation;
+			}
+		}
+
+		return nextRefreshTime;
+	}
+
+	void ThreadMain()
+	{
+		while (!stopping)
+		{
+			const auto nextRefreshTime = Refresh();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			stopCondVar.wait_until(lock, nextRefreshTime, []() { return (bool)stopping; });
+		}
+	}
+
+	curl_slist* BuildList()
+	{
+		curl_slist* newList = nullptr;
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (size_t i = 0; i < std::size(hosts); ++i)
+		{
+			if (addresses[i].empty())
+				continue;
+
+			char entry[512];
+			snprintf(entry, sizeof(entry), "%s:%d:%s", hosts[i], port, addresses[i].c_str());
+
+			curl_slist* appended = curl_slist_append(newList, entry);
+			if (!appended)
+				break;
+
+			newList = appended;
+		}
+
+		return newList;
+	}
+
+	// right before every request, replaces the handle's addresses of the hosts when they changed
+	void Apply(CURL* curl)
+	{
+		if (!enabled)
+			return;
+
+		const uint64_t curGeneration = generation;
+
+		if (curl == appliedCurl && curGeneration == appliedGeneration)
+			return;
+
+		// every request goes through here first, so no handle reads the previous list after it's freed
+		if (curGeneration != listGeneration || !threadList.list)
+		{
+			curl_slist* newList = BuildList();
+			if (!newList)
+				return;
+
+			curl_slist_free_all(threadList.list);
+			threadList.list = newList;
+			listGeneration = curGeneration;
+		}
+
+		curl_easy_setopt(curl, CURLOPT_RESOLVE, threadList.list);
+
+		appliedCurl = curl;
+		appliedGeneration = curGeneration;
+	}
+
+	// resolves everything once before returning so the first requests don't wait either
+	bool Start()
+	{
+		Log(LogChannel::LIBCURL, "Pre-resolving hosts...");
+
+		stopping = false;
+		Refresh();
+
+		size_t resolvedCount = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (const auto& hostAddresses : addresses)
+			{
+				if (!hostAddresses.empty())
+					++resolvedCount;
+			}
+		}
+
+		thread = std::thread(ThreadMain);
+		enabled = true;
+
+		LogAppend("ok, %zu of %zu\n", resolvedCount, std::size(hosts));
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!enabled)
+			return;
+
+		enabled = false;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		stopCondVar.notify_all();
+		thread.join();
+	}
+}
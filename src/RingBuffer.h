@@ -0,0 +1,101 @@
+#pragma once
+
+// bounded multi-producer single-consumer queue, producers never block or take a lock
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// count must be a power of two
+template <typename T, size_t count>
+class CRingBuffer
+{
+	static_assert(count && !(count & (count - 1)), "count must be a power of two");
+
+	class CSlot
+	{
+	public:
+		std::atomic<size_t>	sequence;
+		T					value;
+	};
+
+	CSlot*					slots;
+
+	alignas(64) std::atomic<size_t>	pushPos;
+	alignas(64) std::atomic<size_t>	popPos;
+
+public:
+	CRingBuffer() : pushPos(0), popPos(0)
+	{
+		slots = new CSlot[count];
+
+		for (size_t i = 0; i < count; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~CRingBuffer()
+	{
+		delete[] slots;
+	}
+
+	CRingBuffer(const CRingBuffer&) = delete;
+	CRingBuffer(const CRingBuffer&&) = delete;
+
+	// claims a slot to fill in place, returns nullptr if the buffer is full
+	// every claimed slot must be handed back with EndPush
+	T* BeginPush(size_t* outPos)
+	{
+		size_t pos = pushPos.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			CSlot& slot = slots[pos & (count - 1)];
+
+			const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+			if (!diff)
+			{
+				if (pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					*outPos = pos;
+					return &slot.value;
+				}
+			}
+			else if (diff < 0)
+				return nullptr;
+			else
+				pos = pushPos.load(std::memory_order_relaxed);
+		}
+	}
+
+	// publishes the slot to the consumer
+	void EndPush(size_t pos)
+	{
+		slots[pos & (count - 1)].sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	// consumer only, returns nullptr if there's nothing published at the front
+	T* Peek()
+	{
+		const size_t pos = popPos.load(std::memory_order_relaxed);
+
+		CSlot& slot = slots[pos & (count - 1)];
+
+		if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+			return nullptr;
+
+		return &slot.value;
+	}
+
+	// consumer only, frees the slot returned by Peek
+	void Pop()
+	{
+		const size_t pos = popPos.load(std::memory_order_relaxed);
+
+		slots[pos & (count - 1)].sequence.store(pos + count, std::memory_order_release);
+		popPos.store(pos + 1, std::memory_order_release);
+	}
+
+	// true if every claimed slot has been consumed, approximate while producers are running
+	bool IsEmpty() const
+	{
+		return (pushPos.load(std::memory_order_acquire) == popPos.load(std::memory_order_acquire));
+	}
+};
@@ -0,0 +1,235 @@
+#pragma once
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif // !_WIN32
+
+// --shared-rate-limit makes every instance on the host that uses the same name space its requests together,
+// so accounts can be split over processes without together overrunning the per-IP limits.
+// each rate limiter has a slot in a table in POSIX shared memory holding the time its next request may go,
+// instances reserve a time with a compare-and-swap after their own limiter lets a request through.
+// the steady clock is CLOCK_MONOTONIC, which all processes of the host share
+namespace SharedRateLimit
+{
+	const uint64_t magic = 0x324C52434D4F;	// "OMCRL2"
+
+	// the instance creating the table sizes it for its own limiters times this, so instances on other routes fit too
+	const size_t slotHeadroom = 4;
+	const size_t minSlotCount = 256;
+
+	class CSlot
+	{
+	public:
+		std::atomic<uint64_t>	key;				// hash of the limiter name, 0 while free
+		std::atomic<int64_t>	nextRequestTimeNs;	// steady clock
+	};
+
+	// followed by slotCount slots
+	class CTable
+	{
+	public:
+		std::atomic<uint64_t>	magic;				// set by the creator once slotCount is
+		uint64_t				slotCount;
+
+		CSlot* GetSlots()
+		{
+			return (CSlot*)(this + 1);
+		}
+	};
+
+	// the table is shared between processes, so the atomics can't fall back to locks
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int64_t>::is_always_lock_free,
+		"shared rate limiting needs lock-free 64-bit atomics");
+
+	CTable*		table = nullptr;
+
+	bool IsEnabled()
+	{
+		return table;
+	}
+
+	// FNV-1a, never 0
+	uint64_t HashName(const std::string& name)
+	{
+		uint64_t hash = 0xCBF29CE484222325;
+
+		for (const char c : name)
+		{
+			hash ^= (unsigned char)c;
+			hash *= 0x100000001B3;
+		}
+
+		return hash ? hash : 1;
+	}
+
+	// the limiter's slot in the table, nullptr if it's full
+	CSlot* FindSlot(CTable* inTable, uint64_t key)
+	{
+		CSlot* slots = inTable->GetSlots();
+
+		for (size_t i = 0; i < inTable->slotCount; ++i)
+		{
+			CSlot* slot = &slots[(key + i) % inTable->slotCount];
+
+			uint64_t expected = 0;
+			if (slot->key.compare_exchange_strong(expected, key) || expected == key)
+				return slot;
+		}
+
+		return nullptr;
+	}
+
+#ifndef _WIN32
+	// maps an existing table once its creator has set it up
+	CTable* OpenTable(const char* shmName)
+	{
+		const int fd = shm_open(shmName, O_RDWR, 0600);
+		if (fd < 0)
+			return nullptr;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			struct stat st;
+			if (fstat(fd, &st))
+				break;
+
+			if ((size_t)st.st_size < sizeof(CTable))
+			{
+				std::this_thread::sleep_for(10ms);
+				continue;
+			}
+
+			void* mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mem == MAP_FAILED)
+				break;
+
+			CTable* openedTable = (CTable*)mem;
+
+			if (openedTable->magic == magic &&
+				sizeof(CTable) + openedTable->slotCount * sizeof(CSlot) <= (size_t)st.st_size)
+			{
+				close(fd);
+				return openedTable;
+			}
+
+			munmap(mem, st.st_size);
+			std::this_thread::sleep_for(10ms);
+		}
+
+		close(fd);
+		return nullptr;
+	}
+
+	CTable* CreateTable(const char* shmName, size_t slotCount)
+	{
+		const int fd = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			return nullptr;
+
+		const size_t tableSz = sizeof(CTable) + slotCount * sizeof(CSlot);
+
+		// a new object is zero filled
+		void* mem = MAP_FAILED;
+		if (!ftruncate(fd, tableSz))
+			mem = mmap(nullptr, tableSz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		close(fd);
+
+		if (mem == MAP_FAILED)
+		{
+			shm_unlink(shmName);
+			return nullptr;
+		}
+
+		CTable* newTable = (CTable*)mem;
+		newTable->slotCount = slotCount;
+		newTable->magic = magic;
+
+		return newTable;
+	}
+#endif // !_WIN32
+
+	// claims a slot for every limiter the instance can use up front, so a table that's too small fails startup
+	bool Start(const char* name, const std::vector<std::string>& limiterNames)
+	{
+		Log(LogChannel::GENERAL, "Opening the shared rate limit table...");
+
+#ifdef _WIN32
+		putsnn("fail, not supported on Windows\n");
+		return false;
+#else
+		if (Clock::isVirtual)
+		{
+			putsnn("fail, not with virtual time\n");
+			return false;
+		}
+
+		const std::string shmName = std::string("/omc-ratelimit-") + name;
+
+		const size_t slotCount = std::max(minSlotCount, limiterNames.size() * slotHeadroom);
+
+		CTable* newTable = CreateTable(shmName.c_str(), slotCount);
+		if (!newTable && errno == EEXIST)
+			newTable = OpenTable(shmName.c_str());
+
+		if (!newTable)
+		{
+			putsnn("fail, it doesn't exist and can't be created or was made by an incompatible version\n");
+			return false;
+		}
+
+		for (const auto& limiterName : limiterNames)
+		{
+			if (FindSlot(newTable, HashName(limiterName)))
+				continue;
+
+			LogAppend("fail, no room for %s in its %llu slots, stop every instance using it and delete /dev/shm%s\n",
+				limiterName.c_str(), (unsigned long long)newTable->slotCount, shmName.c_str());
+			munmap(newTable, sizeof(CTable) + newTable->slotCount * sizeof(CSlot));
+			return false;
+		}
+
+		table = newTable;
+
+		LogAppend("ok, %zu limiters\n", limiterNames.size());
+		return true;
+#endif // _WIN32
+	}
+
+	// the limiter's slot, nullptr if sharing is off or the table is full
+	CSlot* GetSlot(const std::string& limiterName)
+	{
+		if (!table)
+			return nullptr;
+
+		CSlot* slot = FindSlot(table, HashName(limiterName));
+		if (!slot)
+		{
+			Log(LogChannel::GENERAL, "Shared rate limit table is full, %s is only limited within this process\n",
+				limiterName.c_str());
+		}
+
+		return slot;
+	}
+
+	// when the calling instance's request may go, the slot after it is taken right away
+	Clock::time_point Reserve(CSlot* slot, std::chrono::microseconds interval)
+	{
+		const int64_t curTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			Clock::Now().time_since_epoch()).count();
+		const int64_t intervalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+
+		int64_t nextRequestTimeNs = slot->nextRequestTimeNs.load();
+		int64_t requestTimeNs;
+
+		do
+		{
+			requestTimeNs = std::max(curTimeNs, nextRequestTimeNs);
+		}
+		while (!slot->nextRequestTimeNs.compare_exchange_weak(nextRequestTimeNs, requestTimeNs + intervalNs));
+
+		return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(requestTimeNs)));
+	}
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+// how long it takes from the market reporting a sale or purchase until we've done our part of the trade
+// sold items are followed by asset id through the sent offer, its confirmation and trade-ready,
+// bought items by bot id until we accept the bot's offer
+// items already waiting when the client starts count from startup
+namespace Sla
+{
+	enum class Stage
+	{
+		GIVE_SENT,			// sale detected until the offer is sent
+		GIVE_CONFIRMED,		// offer sent until it's confirmed
+		GIVE_TRADE_READY,	// confirmed until the market is told about it
+		GIVE_TOTAL,			// sale detected until trade-ready
+		TAKE_TOTAL,			// purchase detected until the bot's offer is accepted
+
+		COUNT
+	};
+
+	const char* stageNames[] =
+	{
+		"give_sent",
+		"give_confirmed",
+		"give_trade_ready",
+		"give_total",
+		"take_total",
+	};
+
+	class CStats
+	{
+	public:
+		std::string	account;
+		int			market;
+		CHistogram	stages[(size_t)Stage::COUNT];	// microseconds
+
+		CStats(const char* accountName, int marketIndex) : account(accountName), market(marketIndex)
+		{
+
+		}
+	};
+
+	// stats outlive the accounts, entries are never removed so pointers stay valid
+	std::mutex								statsMutex;
+	std::vector<std::unique_ptr<CStats>>	stats;
+
+	CStats* GetStats(const char* account, int market)
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+
+		for (const auto& entry : stats)
+		{
+			if (entry->market == market && entry->account == account)
+				return entry.get();
+		}
+
+		stats.emplace_back(std::make_unique<CStats>(account, market));
+		return stats.back().get();
+	}
+
+	// calls callback(const CStats*) for every account and market pair seen so far
+	template <typename F>
+	void ForEachStats(F callback)
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+
+		for (const auto& entry : stats)
+			callback(entry.get());
+	}
+
+	// market item values are strings or numbers depending on the endpoint
+	inline std::string GetIdString(const rapidjson::Value& value)
+	{
+		if (value.IsString())
+			return value.GetString();
+
+		if (value.IsUint64())
+			return std::to_string(value.GetUint64());
+
+		return std::string();
+	}
+
+	inline int64_t GetTimeUs()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			Clock::Now().time_since_epoch()).count();
+	}
+
+	// per account, only used by the thread running the account
+	class CTracker
+	{
+		class CItem
+		{
+		public:
+			int			market;
+			bool		sold;			// false if bought
+			std::string	key;			// asset id of sold items, market item id of bought items
+			std::string	botId;			// bought items only
+			std::string	offerId;
+			int64_t		detectedUs;
+			int64_t		sentUs = 0;
+			int64_t		confirmedUs = 0;
+		};
+
+		std::vector<CItem> items;
+
+		static void Record(const char* account, int market, Stage stage, int64_t durationUs)
+		{
+			GetStats(account, market)->stages[(size_t)stage].Record(std::max<int64_t>(durationUs, 0));
+		}
+
+	public:
+		void OnSaleDetected(int market, const std::string& assetId)
+		{
+			if (assetId.empty())
+				return;
+
+			for (const auto& item : items)
+			{
+				if (item.sold && item.market == market && item.key == assetId)
+					return;
+			}
+
+			CItem item;
+			item.market = market;
+			item.sold = true;
+			item.key = assetId;
+			item.detectedUs = GetTimeUs();
+
+			items.emplace_back(std::move(item));
+		}
+
+		void OnPurchaseDetected(int market, const std::string& itemId, const std::string& botId)
+		{
+			if (itemId.empty())
+				return;
+
+			for (const auto& item : items)
+			{
+				if (!item.sold && item.market == market && item.key == itemId)
+					return;
+			}
+
+			CItem item;
+			item.market = market;
+			item.sold = false;
+			item.key = itemId;
+			item.botId = botId;
+			item.detectedUs = GetTimeUs();
+
+			items.emplace_back(std::move(item));
+		}
+
+		// offerItems is the items array of a p2p offer, its asset ids are matched against the sold items.
+		// sending the item again in another offer counts as sent once more, still from when the sale was detected
+		void OnOfferSent(const char* account, int market, const rapidjson::Value& offerItems, const char* offerId)
+		{
+			if (!offerItems.IsArray())
+				return;
+
+			const int64_t curTimeUs = GetTimeUs();
+
+			for (const auto& offerItem : offerItems.GetArray())
+			{
+				const auto iterAssetId = offerItem.FindMember("assetid");
+				if (iterAssetId == offerItem.MemberEnd())
+					continue;
+
+				const std::string assetId = GetIdString(iterAssetId->value);
+
+				for (auto& item : items)
+				{
+					if (!item.sold || item.market != market || item.key != assetId || item.offerId == offerId)
+						continue;
+
+					// a re-send after the previous offer was declined or expired starts the later stages over
+					item.sentUs = curTimeUs;
+					item.confirmedUs = 0;
+					item.offerId = offerId;
+
+					Record(account, market, Stage::GIVE_SENT, curTimeUs - item.detectedUs);
+				}
+			}
+		}
+
+		void OnOfferConfirmed(const char* account, int market, const char* offerId)
+		{
+			const int64_t curTimeUs = GetTimeUs();
+
+			for (auto& item : items)
+			{
+				if (item.market != market || item.offerId != offerId || item.confirmedUs)
+					continue;
+
+				item.confirmedUs = curTimeUs;
+
+				Record(account, market, Stage::GIVE_CONFIRMED, curTimeUs - item.sentUs);
+			}
+		}
+
+		// the sold items of the offer are done
+		void OnTradeReady(const char* account, int market, const char* offerId)
+		{
+			const int64_t curTimeUs = GetTimeUs();
+
+			items.erase(std::remove_if(items.begin(), items.end(), [&](const CItem& item)
+			{
+				if (item.market != market || item.offerId != offerId || !item.confirmedUs)
+					return false;
+
+				Record(account, market, Stage::GIVE_TRADE_READY, curTimeUs - item.confirmedUs);
+				Record(account, market, Stage::GIVE_TOTAL, curTimeUs - item.detectedUs);
+				return true;
+			}), items.end());
+		}
+
+		// the bot's offer carries every item bought from it
+		void OnBotOfferAccepted(const char* account, int market, const char* botId)
+		{
+			if (!botId)
+				return;
+
+			const int64_t curTimeUs = GetTimeUs();
+
+			items.erase(std::remove_if(items.begin(), items.end(), [&](const CItem& item)
+			{
+				if (item.sold || item.market != market || item.botId != botId)
+					return false;
+
+				Record(account, market, Stage::TAKE_TOTAL, curTimeUs - item.detectedUs);
+				return true;
+			}), items.end());
+		}
+
+		// forgets items of the market that are no longer waiting for us, e.g. the market cancelled the trade
+		void Prune(int market, const std::unordered_set<std::string>& waitingKeys)
+		{
+			items.erase(std::remove_if(items.begin(), items.end(), [&](const CItem& item)
+			{
+				return (item.market == market && !waitingKeys.count(item.key));
+			}), items.end());
+		}
+	};
+
+	void Dump()
+	{
+		Log(LogChannel::GENERAL, "Sale to delivery times (s) per account and market:\n");
+
+		ForEachStats([](const CStats* entry)
+		{
+			for (size_t i = 0; i < (size_t)Stage::COUNT; ++i)
+			{
+				const CHistogram& stage = entry->stages[i];
+				if (!stage.GetCount())
+					continue;
+
+				Log(LogChannel::GENERAL, "%s [%s] %-16s n %-6llu p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f\n",
+					entry->account.c_str(),
+					Market::marketNames[entry->market],
+					stageNames[i],
+					(unsigned long long)stage.GetCount(),
+					stage.GetQuantile(0.50) / 1e6,
+					stage.GetQuantile(0.90) / 1e6,
+					stage.GetQuantile(0.99) / 1e6,
+					stage.GetMax() / 1e6);
+			}
+		});
+	}
+}
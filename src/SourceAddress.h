@@ -0,0 +1,157 @@
+#pragma once
+
+// --source-address-file binds accounts to local interfaces or addresses, so a multi-homed host spreads its accounts
+// over its IPs and the per-IP limits of Steam and the market. one binding per line in CURLOPT_INTERFACE form
+// (eth1, 192.0.2.10, if!eth1, host!192.0.2.10), "account binding" pins an account, the rest go round-robin
+namespace SourceAddress
+{
+	std::vector<std::string>						pool;		// round-robin
+	std::unordered_map<std::string, std::string>	pinned;		// account name to binding
+
+	// round-robin account name to index in pool
+	std::unordered_map<std::string, size_t>			assignments;
+	size_t											nextAddress = 0;
+
+	// binding of the account this thread is running, nullptr if none
+	thread_local const std::string*					currentAddress = nullptr;
+
+	// libcurl hands an unbound request any idle connection, bound ones included, but a bound request only one bound
+	// the same way. so once a file is loaded, unbound requests are bound to the wildcard address instead,
+	// which leaves the source address to the system like no binding does
+	const char										anyAddress[] = "host!0.0.0.0";
+
+	bool IsLoaded()
+	{
+		return (!pool.empty() || !pinned.empty());
+	}
+
+	bool Load(const char* path)
+	{
+		Log(LogChannel::LIBCURL, "Loading the source address list...");
+
+		FILE* file = u8fopen(path, "rb");
+		if (!file)
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		char line[512];
+
+		while (fgets(line, sizeof(line), file))
+		{
+			char* first = line + strspn(line, " \t");
+			const size_t firstLen = strcspn(first, " \t\r\n");
+
+			if (!firstLen || first[0] == '#')
+				continue;
+
+			char* second = first + firstLen + strspn(first + firstLen, " \t");
+			const size_t secondLen = strcspn(second, " \t\r\n");
+
+			if (secondLen)
+				pinned[std::string(first, firstLen)] = std::string(second, secondLen);
+			else
+				pool.emplace_back(first, firstLen);
+		}
+
+		fclose(file);
+
+		if (pool.empty() && pinned.empty())
+		{
+			putsnn("fail, no addresses in the file\n");
+			return false;
+		}
+
+		LogAppend("ok, %zu round-robin, %zu pinned\n", pool.size(), pinned.size());
+		return true;
+	}
+
+	// nullptr if the account isn't pinned and there's no round-robin pool
+	const std::string* Assign(const char* accountName)
+	{
+		const auto iterPinned = pinned.find(accountName);
+		if (iterPinned != pinned.end())
+			return &iterPinned->second;
+
+		if (pool.empty())
+			return nullptr;
+
+		auto iter = assignments.find(accountName);
+		if (iter == assignments.end())
+			iter = assignments.emplace(accountName, nextAddress++ % pool.size()).first;
+
+		return &pool[iter->second];
+	}
+
+	void Unassign(const char* accountName)
+	{
+		assignments.erase(accountName);
+	}
+
+	// binds the requests of this thread to the account's address until it goes out of scope
+	class CAccountScope
+	{
+		CURL*	curl;
+
+	public:
+		CAccountScope(CURL* curlHandle, const char* accountName) : curl(curlHandle)
+		{
+			if (!IsLoaded())
+				return;
+
+			currentAddress = Assign(accountName);
+			curl_easy_setopt(curl, CURLOPT_INTERFACE, currentAddress ? currentAddress->c_str() : anyAddress);
+		}
+
+		~CAccountScope()
+		{
+			if (!IsLoaded())
+				return;
+
+			currentAddress = nullptr;
+			curl_easy_setopt(curl, CURLOPT_INTERFACE, anyAddress);
+		}
+
+		CAccountScope(const CAccountScope&) = delete;
+		CAccountScope(const CAccountScope&&) = delete;
+	};
+
+	// what the servers see a request of this thread come from: the account's proxy, else its binding,
+	// "" for the default route. rate limits and backoff are kept per route
+	const char* GetRoute()
+	{
+		if (0 <= ProxyPool::currentProxy)
+			return ProxyPool::proxies[ProxyPool::currentProxy].label.c_str();
+
+		return currentAddress ? currentAddress->c_str() : "";
+	}
+
+	// every route GetRoute can return once the proxy and address lists are loaded
+	std::vector<std::string> GetRoutes()
+	{
+		std::vector<std::string> routes = { "" };
+
+		auto add = [&routes](const std::string& route)
+		{
+			if (std::find(routes.begin(), routes.end(), route) == routes.end())
+				routes.push_back(route);
+		};
+
+		if (!ProxyPool::proxies.empty())
+		{
+			for (const auto& proxy : ProxyPool::proxies)
+				add(proxy.label);
+
+			return routes;
+		}
+
+		for (const auto& address : pool)
+			add(address);
+
+		for (const auto& entry : pinned)
+			add(entry.second);
+
+		return routes;
+	}
+}
@@ -52,7 +52,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/login/getrsakey/");
+			Curl::SetUrl(curl, "https://steamcommunity.com/login/getrsakey/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -232,7 +232,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/login/dologin/");
+			Curl::SetUrl(curl, "https://steamcommunity.com/login/dologin/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 			curl_easy_setopt(curl, CURLOPT_COOKIE, "mobileClient=android");
@@ -278,7 +278,8 @@ namespace Steam
 					const char* msg = iterMessage->value.GetString();
 					if (msg[0])
 					{
-						puts(msg); // we need newline
+						putsnn(msg);
+						putsnn("\n"); // we need newline
 						return LoginResult::UNSUCCEDED;
 					}
 				}
@@ -329,7 +330,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://api.steampowered.com/IMobileAuthService/GetWGToken/v1/");
+			Curl::SetUrl(curl, "https://api.steampowered.com/IMobileAuthService/GetWGToken/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -399,7 +400,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, url);
+			Curl::SetUrl(curl, url);
 			curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 			const CURLcode respCode = curl_easy_perform(curl);
@@ -512,7 +513,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, 
+			Curl::SetUrl(curl, 
 				"https://api.steampowered.com/IAuthenticationService/BeginAuthSessionViaCredentials/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
@@ -586,7 +587,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, 
+			Curl::SetUrl(curl, 
 				"https://api.steampowered.com/IAuthenticationService/UpdateAuthSessionWithSteamGuardCode/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
@@ -630,7 +631,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL,"https://api.steampowered.com/IAuthenticationService/PollAuthSessionStatus/v1/");
+			Curl::SetUrl(curl, "https://api.steampowered.com/IAuthenticationService/PollAuthSessionStatus/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -696,7 +697,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, 
+			Curl::SetUrl(curl, 
 				"https://api.steampowered.com/IAuthenticationService/GenerateAccessTokenForApp/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
@@ -737,7 +738,7 @@ namespace Steam
 		{
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, 
+			Curl::SetUrl(curl, 
 				"https://login.steampowered.com/jwt/refresh?redir=https://steamcommunity.com/");
 			curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
@@ -769,7 +770,7 @@ namespace Steam
 				return false;
 			}
 
-			curl_easy_setopt(curl, CURLOPT_URL, followUrl);
+			Curl::SetUrl(curl, followUrl);
 
 			const CURLcode respCodeFollow = curl_easy_perform(curl);
 
@@ -14,7 +14,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/login/refreshcaptcha/");
+			Curl::SetUrl(curl, "https://steamcommunity.com/login/refreshcaptcha/");
 			curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 			const CURLcode respCode = curl_easy_perform(curl);
@@ -41,7 +41,7 @@ namespace Steam
 			else
 				strcpy(out, "-1");
 
-			printf("ok\n");
+			putsnn("ok\n");
 			return true;
 		}
 
@@ -71,7 +71,7 @@ namespace Steam
 
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
 			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL); // set write callback to default file write
-			curl_easy_setopt(curl, CURLOPT_URL, url);
+			Curl::SetUrl(curl, url);
 			curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 			const CURLcode respCode = curl_easy_perform(curl);
@@ -9,6 +9,8 @@ namespace Steam
 		const size_t deviceIdBufSz = sizeof("android:") - 1 + 36 + 1;
 
 		const size_t twoFactorCodeBufSz = 5 + 1;
+		const time_t twoFactorCodeInterval = 30;
+		const time_t twoFactorCodeMinTimeLeft = 5; // with less left the code may roll over before Steam checks it
 		const size_t confTagMaxLen = 32; // everyone does 32 char tag limit, no idea why
 		const size_t confHashSz = PlainToBase64Size(WC_SHA_DIGEST_SIZE, WC_NO_NL_ENC);
 		const size_t confIdBufSz = UINT64_MAX_STR_SIZE;
@@ -21,21 +23,41 @@ namespace Steam
 			sizeof("&t=") - 1 + UINT64_MAX_STR_SIZE - 1 +
 			sizeof("&tag=") - 1 + confTagMaxLen + 1;
 
-		time_t timeDiff = 0;
+		// Steam time is kept as an offset from the monotonic clock so wall clock steps don't affect it
+		std::atomic<int64_t> steamTimeOffsetMs(0);
 
-		bool SyncTime(CURL* curl)
+		// how fast the offset moves, i.e. how much the local clock drifts from Steam's
+		std::atomic<int64_t> steamTimeDriftMsPerHour(0);
+
+		const auto timeResyncInterval = 15min;
+
+		inline int64_t GetTimeDriftMsPerHour()
 		{
-			Log(LogChannel::STEAM, "Syncing time...");
+			return steamTimeDriftMsPerHour;
+		}
+
+		inline int64_t GetSteadyTimeMs()
+		{
+			return std::chrono::duration_cast<std::chrono::milliseconds>(
+				Clock::Now().time_since_epoch()).count();
+		}
 
-			curl_easy_setopt(curl, CURLOPT_URL, "https://api.steampowered.com/ITwoFactorService/QueryTime/v1/");
+		// measures the offset of Steam time from the monotonic clock
+		bool QueryTimeOffset(CURL* curl, int64_t* outOffsetMs)
+		{
+			Curl::SetUrl(curl, "https://api.steampowered.com/ITwoFactorService/QueryTime/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
 
+			const int64_t requestStartMs = GetSteadyTimeMs();
+
 			const CURLcode respCode = curl_easy_perform(curl);
 
+			const int64_t requestEndMs = GetSteadyTimeMs();
+
 			if (respCode != CURLE_OK)
 			{
 				Curl::PrintError(curl, respCode);
@@ -60,35 +82,278 @@ namespace Steam
 
 			const char* serverTime = iterResponse->value["server_time"].GetString();
 
-			timeDiff = time(nullptr) - atoll(serverTime);
+			// the server time was taken somewhere during the request and is truncated to seconds,
+			// so assume the middle of both
+			const int64_t serverTimeMs = atoll(serverTime) * 1000 + 500;
+
+			*outOffsetMs = serverTimeMs - (requestStartMs + requestEndMs) / 2;
+			return true;
+		}
+
+		bool SyncTime(CURL* curl)
+		{
+			Log(LogChannel::STEAM, "Syncing time...");
+
+			int64_t offsetMs;
+			if (!QueryTimeOffset(curl, &offsetMs))
+				return false;
+
+			steamTimeOffsetMs = offsetMs;
 
 			putsnn("ok\n");
 			return true;
 		}
 
+		// raw offsets the drift is fitted over, the first and last of them
+		const size_t timeDriftWindowSz = 5;
+
+		// keeps Steam time in sync on long running hosts,
+		// the applied offset is smoothed since each measurement is off by up to half a request's round trip,
+		// the drift is fitted from the raw measurements so the smoothing doesn't lag it
+		void TrackTimeDrift(CURL* curl)
+		{
+			// the offset SyncTime measured right before this started is the first sample
+			std::deque<std::pair<int64_t, int64_t>> samples;	// steady time, offset
+			samples.emplace_back(GetSteadyTimeMs(), steamTimeOffsetMs.load());
+
+			while (SleepUnlessExiting(timeResyncInterval))
+			{
+				int64_t sampleOffsetMs;
+				if (!QueryTimeOffset(curl, &sampleOffsetMs))
+				{
+					Log(LogChannel::STEAM, "Resyncing time failed\n");
+					continue;
+				}
+
+				const int64_t curTimeMs = GetSteadyTimeMs();
+				const int64_t offsetMs = steamTimeOffsetMs;
+				const int64_t errorMs = sampleOffsetMs - offsetMs;
+
+				int64_t newOffsetMs;
+
+				// way more than a round trip, something changed on Steam's side, don't smooth it in slowly
+				if (5000 < std::abs(errorMs))
+				{
+					newOffsetMs = sampleOffsetMs;
+					samples.clear();
+					Log(LogChannel::STEAM, "Steam time jumped by %lld ms\n", (long long)errorMs);
+				}
+				else
+					newOffsetMs = offsetMs + errorMs / 4;
+
+				samples.emplace_back(curTimeMs, sampleOffsetMs);
+				if (timeDriftWindowSz < samples.size())
+					samples.pop_front();
+
+				if (2 <= samples.size())
+				{
+					const int64_t hourMs = 60 * 60 * 1000;
+					steamTimeDriftMsPerHour = (samples.back().second - samples.front().second) * hourMs /
+						std::max<int64_t>(samples.back().first - samples.front().first, 1);
+				}
+
+				steamTimeOffsetMs = newOffsetMs;
+
+				Log(LogChannel::STEAM, "Time resynced, corrected by %lld ms, drift %lld ms/h\n",
+					(long long)(newOffsetMs - offsetMs), (long long)GetTimeDriftMsPerHour());
+			}
+		}
+
+		// runs TrackTimeDrift on its own copy of the handle, curl handles can't be shared between threads.
+		// the copy drops the session cookies, the time query doesn't need them
+		std::thread StartTimeDriftTracking(CURL* curl)
+		{
+			CURL* curlCopy = curl_easy_duphandle(curl);
+			if (!curlCopy)
+			{
+				Log(LogChannel::STEAM, "Time drift tracking disabled: handle duplication failed\n");
+				return std::thread();
+			}
+
+			curl_easy_setopt(curlCopy, CURLOPT_COOKIELIST, "ALL");
+
+			return std::thread([curlCopy]()
+				{
+					TrackTimeDrift(curlCopy);
+					curl_easy_cleanup(curlCopy);
+				});
+		}
+
 		inline time_t GetSteamTime()
 		{
-			return time(nullptr) + timeDiff;
+			return (GetSteadyTimeMs() + steamTimeOffsetMs) / 1000;
 		}
 
-		// out buffer size must be at least twoFactorCodeBufSz
-		bool GenerateTwoFactorAuthCode(const char* sharedSecret, char* out)
+		// returns the current two factor code window, or the next one if the current is about to roll over
+		time_t GetUsableTwoFactorCodeWindow()
 		{
-			Log(LogChannel::STEAM, "Generating two factor auth code...");
+			const time_t steamTime = GetSteamTime();
+			const time_t window = (steamTime / twoFactorCodeInterval);
+
+			if ((twoFactorCodeInterval - (steamTime % twoFactorCodeInterval)) < twoFactorCodeMinTimeLeft)
+				return window + 1;
+
+			return window;
+		}
+
+		// sleeps until the window starts, returns immediately if it already has
+		void WaitForTwoFactorCodeWindow(time_t window)
+		{
+			const time_t waitTime = (window * twoFactorCodeInterval) - GetSteamTime();
+			if (waitTime <= 0)
+				return;
+
+			Log(LogChannel::STEAM, "Waiting %lld seconds for the next two factor code\n", (long long)waitTime);
+			Clock::SleepFor(std::chrono::seconds(waitTime));
+		}
 
-			byte rawShared[WC_SHA_DIGEST_SIZE + 1];
-			word32 rawSharedSz = sizeof(rawShared);
+		// HMAC-SHA1 keyed once: the secret is decoded and the inner and outer pad blocks are hashed up front,
+		// each message then only clones the two SHA states
+		class CHmacSha1Key
+		{
+			wc_Sha	innerSha;
+			wc_Sha	outerSha;
+			bool	initialized = false;
 
-			if (Base64_Decode((byte*)sharedSecret, secretsSz, rawShared, &rawSharedSz))
+		public:
+			CHmacSha1Key()
 			{
-				putsnn("shared secret decoding failed\n");
-				return false;
+
+			}
+
+			~CHmacSha1Key()
+			{
+				Clear();
+			}
+
+			// no implicit copies of the key, moving hands the SHA states over and wipes the source
+			CHmacSha1Key(const CHmacSha1Key&) = delete;
+			CHmacSha1Key& operator=(const CHmacSha1Key&) = delete;
+
+			CHmacSha1Key(CHmacSha1Key&& other) noexcept
+			{
+				*this = std::move(other);
+			}
+
+			CHmacSha1Key& operator=(CHmacSha1Key&& other) noexcept
+			{
+				if (this == &other)
+					return *this;
+
+				Clear();
+
+				if (!other.initialized)
+					return *this;
+
+				memcpy(&innerSha, &other.innerSha, sizeof(innerSha));
+				memcpy(&outerSha, &other.outerSha, sizeof(outerSha));
+				initialized = true;
+
+				// freeing the source would free what was just handed over
+				SecureZero(&other.innerSha, sizeof(other.innerSha));
+				SecureZero(&other.outerSha, sizeof(other.outerSha));
+				other.initialized = false;
+
+				return *this;
+			}
+
+			bool IsInitialized() const
+			{
+				return initialized;
 			}
 
+			void Clear()
+			{
+				if (initialized)
+				{
+					wc_ShaFree(&innerSha);
+					wc_ShaFree(&outerSha);
+				}
+
+				SecureZero(&innerSha, sizeof(innerSha));
+				SecureZero(&outerSha, sizeof(outerSha));
+				initialized = false;
+			}
+
+			// secret is base64 encoded, secretsSz long
+			bool Init(const char* secret)
+			{
+				Clear();
+
+				byte rawSecret[WC_SHA_DIGEST_SIZE + 1];
+				word32 rawSecretSz = sizeof(rawSecret);
+
+				if (Base64_Decode((const byte*)secret, secretsSz, rawSecret, &rawSecretSz))
+					return false;
+
+				// https://www.rfc-editor.org/rfc/rfc2104#section-2
+				byte pad[WC_SHA_BLOCK_SIZE] = { 0 };
+				memcpy(pad, rawSecret, rawSecretSz);
+				SecureZero(rawSecret, sizeof(rawSecret));
+
+				for (byte& b : pad)
+					b ^= 0x36;
+
+				bool success = (!wc_InitSha(&innerSha) && !wc_ShaUpdate(&innerSha, pad, sizeof(pad)));
+
+				// 0x36 ^ 0x5C, turns ipad into opad
+				for (byte& b : pad)
+					b ^= 0x6A;
+
+				success = (success && !wc_InitSha(&outerSha) && !wc_ShaUpdate(&outerSha, pad, sizeof(pad)));
+
+				SecureZero(pad, sizeof(pad));
+
+				if (!success)
+				{
+					// either may have been initialized
+					wc_ShaFree(&innerSha);
+					wc_ShaFree(&outerSha);
+					Clear();
+					return false;
+				}
+
+				initialized = true;
+				return true;
+			}
+
+			// out buffer size must be at least WC_SHA_DIGEST_SIZE
+			bool Compute(const byte* msg, word32 msgSz, byte* out)
+			{
+				if (!initialized)
+					return false;
+
+				byte innerHash[WC_SHA_DIGEST_SIZE];
+
+				wc_Sha sha;
+
+				bool success =
+					(!wc_ShaCopy(&innerSha, &sha) &&
+						!wc_ShaUpdate(&sha, msg, msgSz) &&
+						!wc_ShaFinal(&sha, innerHash));
+
+				wc_ShaFree(&sha);
+
+				success = (success &&
+					!wc_ShaCopy(&outerSha, &sha) &&
+					!wc_ShaUpdate(&sha, innerHash, sizeof(innerHash)) &&
+					!wc_ShaFinal(&sha, out));
+
+				wc_ShaFree(&sha);
+
+				return success;
+			}
+		};
+
+		// window is Steam time divided by twoFactorCodeInterval
+		// out buffer size must be at least twoFactorCodeBufSz
+		bool GenerateTwoFactorAuthCode(CHmacSha1Key* sharedKey, time_t window, char* out)
+		{
+			Log(LogChannel::STEAM, "Generating two factor auth code...");
+
 			// https://en.wikipedia.org/wiki/Time-based_one-time_password
 			// https://www.rfc-editor.org/rfc/rfc4226#section-5.3
-			const time_t totpInterval = 30;
-			time_t totpCounter = (GetSteamTime() / totpInterval);
+			time_t totpCounter = window;
 
 			// The Key (K), the Counter (C), and Data values are hashed high-order byte first
 #ifdef LITTLE_ENDIAN_ORDER
@@ -97,10 +362,7 @@ namespace Steam
 
 			byte hmacHash[WC_SHA_DIGEST_SIZE];
 
-			Hmac hmac;
-			if (wc_HmacSetKey(&hmac, WC_SHA, rawShared, rawSharedSz) ||
-				wc_HmacUpdate(&hmac, (byte*)&totpCounter, sizeof(totpCounter)) ||
-				wc_HmacFinal(&hmac, hmacHash))
+			if (!sharedKey->Compute((byte*)&totpCounter, sizeof(totpCounter), hmacHash))
 			{
 				putsnn("HMAC failed\n");
 				return false;
@@ -132,7 +394,7 @@ namespace Steam
 
 		// out buffer size must be at least confHashBufSz
 		// outLen is the size of out buffer on input and result size on output
-		bool GenerateConfirmationHash(const char* identitySecret, time_t timestamp, const char* tag, byte* out, word32* outSz)
+		bool GenerateConfirmationHash(CHmacSha1Key* identityKey, time_t timestamp, const char* tag, byte* out, word32* outSz)
 		{
 			size_t tagLen = strlen(tag);
 			if (tagLen > confTagMaxLen)
@@ -150,24 +412,17 @@ namespace Steam
 
 			memcpy(msg + sizeof(timestamp), tag, tagLen);
 
-			byte rawIdentity[WC_SHA_DIGEST_SIZE + 1];
-			word32 rawIdentitySz = sizeof(rawIdentity);
-
-			Hmac hmac;
 			byte hmacHash[WC_SHA_DIGEST_SIZE];
 
 			const bool success =
-				(!Base64_Decode((byte*)identitySecret, secretsSz, rawIdentity, &rawIdentitySz) &&
-					!wc_HmacSetKey(&hmac, WC_SHA, rawIdentity, rawIdentitySz) &&
-					!wc_HmacUpdate(&hmac, msg, msgSz) &&
-					!wc_HmacFinal(&hmac, hmacHash) &&
+				(identityKey->Compute(msg, msgSz, hmacHash) &&
 					!Base64_Encode_NoNl(hmacHash, sizeof(hmacHash), out, outSz));
 
 			return success;
 		}
 
 		// out buffer size must be at least confQueueParamsBufSz
-		bool GenerateConfirmationQueryParams(CURL* curl, const char* steamId64, const char* identitySecret, 
+		bool GenerateConfirmationQueryParams(CURL* curl, const char* steamId64, CHmacSha1Key* identityKey, 
 			const char* deviceId, const char* tag, char* out)
 		{
 			const time_t timestamp = GetSteamTime();
@@ -175,7 +430,7 @@ namespace Steam
 			byte hash[confHashSz];
 			word32 hashSz = confHashSz;
 
-			if (!GenerateConfirmationHash(identitySecret, timestamp, tag, hash, &hashSz))
+			if (!GenerateConfirmationHash(identityKey, timestamp, tag, hash, &hashSz))
 				return false;
 
 			char* escapedHash = curl_easy_escape(curl, (char*)hash, hashSz);
@@ -197,13 +452,13 @@ namespace Steam
 			return true;
 		}
 
-		bool FetchConfirmations(CURL* curl, const char* steamId64, const char* identitySecret, 
+		bool FetchConfirmations(CURL* curl, const char* steamId64, CHmacSha1Key* identityKey, 
 			const char* deviceId, rapidjson::Document* out)
 		{
 			Log(LogChannel::STEAM, "Fetching confirmations...");
 
 			char postFields[confQueueParamsBufSz];
-			if (!GenerateConfirmationQueryParams(curl, steamId64, identitySecret, deviceId, "conf", postFields))
+			if (!GenerateConfirmationQueryParams(curl, steamId64, identityKey, deviceId, "conf", postFields))
 			{
 				putsnn("query params generation failed\n");
 				return false;
@@ -211,7 +466,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/mobileconf/getlist");
+			Curl::SetUrl(curl, "https://steamcommunity.com/mobileconf/getlist");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -242,10 +497,12 @@ namespace Steam
 		}
 
 		bool AcceptConfirmation(CURL* curl, 
-			const char* steamId64, const char* identitySecret, const char* deviceId, const char* offerId)
+			const char* steamId64, CHmacSha1Key* identityKey, const char* deviceId, const char* offerId)
 		{
+			RateLimiter::CPriorityScope priority(RateLimiter::Priority::CONFIRMATION);
+
 			rapidjson::Document docConfs;
-			if (!FetchConfirmations(curl, steamId64, identitySecret, deviceId, &docConfs))
+			if (!FetchConfirmations(curl, steamId64, identityKey, deviceId, &docConfs))
 				return false;
 
 			Log(LogChannel::STEAM, "Accepting confirmation...");
@@ -260,7 +517,7 @@ namespace Steam
 
 			char postFields[postFieldsBufSz];
 
-			if (!GenerateConfirmationQueryParams(curl, steamId64, identitySecret, deviceId, "allow", postFields))
+			if (!GenerateConfirmationQueryParams(curl, steamId64, identityKey, deviceId, "allow", postFields))
 			{
 				putsnn("query params generation failed\n");
 				return false;
@@ -297,7 +554,7 @@ namespace Steam
 
 			Curl::CResponse respOp;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &respOp);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/mobileconf/ajaxop");
+			Curl::SetUrl(curl, "https://steamcommunity.com/mobileconf/ajaxop");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -330,11 +587,13 @@ namespace Steam
 
 		// unused
 		bool AcceptConfirmations(CURL* curl, 
-			const char* steamId64, const char* identitySecret, const char* deviceId, 
+			const char* steamId64, CHmacSha1Key* identityKey, const char* deviceId, 
 			const char** offerIds, size_t offerIdCount)
 		{
+			RateLimiter::CPriorityScope priority(RateLimiter::Priority::CONFIRMATION);
+
 			rapidjson::Document docConfs;
-			if (!FetchConfirmations(curl, steamId64, identitySecret, deviceId, &docConfs))
+			if (!FetchConfirmations(curl, steamId64, identityKey, deviceId, &docConfs))
 				return false;
 
 			Log(LogChannel::STEAM, "Accepting confirmations...");
@@ -351,7 +610,7 @@ namespace Steam
 				return false;
 			}
 
-			if (!GenerateConfirmationQueryParams(curl, steamId64, identitySecret, deviceId, "allow", postFields))
+			if (!GenerateConfirmationQueryParams(curl, steamId64, identityKey, deviceId, "allow", postFields))
 			{
 				free(postFields);
 				putsnn("query params generation failed\n");
@@ -395,7 +654,7 @@ namespace Steam
 
 			Curl::CResponse respMultiOp;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &respMultiOp);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/mobileconf/multiajaxop");
+			Curl::SetUrl(curl, "https://steamcommunity.com/mobileconf/multiajaxop");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -425,7 +684,7 @@ namespace Steam
 			}
 
 			if (confirmedCount != offerIdCount)
-				printf("accepted %zu out of %zu\n", confirmedCount, offerIdCount);
+				LogAppend("accepted %zu out of %zu\n", confirmedCount, offerIdCount);
 			else
 				putsnn("ok\n");
 
@@ -454,7 +713,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://api.steampowered.com/ITwoFactorService/QueryStatus/v1/");
+			Curl::SetUrl(curl, "https://api.steampowered.com/ITwoFactorService/QueryStatus/v1/");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -13,7 +13,7 @@ namespace Steam
 
 		Curl::CResponse respKey;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &respKey);
-		curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/dev/apikey?l=english");
+		Curl::SetUrl(curl, "https://steamcommunity.com/dev/apikey?l=english");
 		curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 		CURLcode respCode = curl_easy_perform(curl);
@@ -47,7 +47,7 @@ namespace Steam
 			strcpy(postFieldsEnd, sessionId);
 
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &respRegister);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/dev/registerkey");
+			Curl::SetUrl(curl, "https://steamcommunity.com/dev/registerkey");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -114,12 +114,16 @@ namespace Steam
 	{
 		char cookie[1024];
 
+		std::string scopeDomain, scopePath;
+		bool secure;
+		Curl::GetCookieScope(domain, &scopeDomain, &scopePath, &secure);
+
 		char* cookieEnd = cookie;
-		cookieEnd = stpcpy(cookieEnd, domain); 	/* Hostname */
-		cookieEnd = stpcpy(cookieEnd, "\tFALSE"	/* Include subdomains */
-			"\t/"								/* Path */
-			"\tTRUE"							/* Secure */
-			"\t0"								/* Expiry in epoch time format. 0 == session */
+		cookieEnd = stpcpy(cookieEnd, scopeDomain.c_str()); 	/* Hostname */
+		cookieEnd = stpcpy(cookieEnd, "\tFALSE\t");				/* Include subdomains */
+		cookieEnd = stpcpy(cookieEnd, scopePath.c_str());		/* Path */
+		cookieEnd = stpcpy(cookieEnd, secure ? "\tTRUE" : "\tFALSE");	/* Secure */
+		cookieEnd = stpcpy(cookieEnd, "\t0"		/* Expiry in epoch time format. 0 == session */
 			"\t");
 		cookieEnd = stpcpy(cookieEnd, name);	/* Name */
 		*cookieEnd++ = '\t';
@@ -217,7 +221,7 @@ namespace Steam
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_POST, 1L);
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -318,7 +322,7 @@ namespace Steam
 
 		Curl::CResponse respSet;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &respSet);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		Curl::SetUrl(curl, url);
 		curl_easy_setopt(curl, CURLOPT_POST, 1L);
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -377,7 +381,7 @@ namespace Steam
 
 		Curl::CResponse response;
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-		curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com//trade/new/acknowledge");
+		Curl::SetUrl(curl, "https://steamcommunity.com//trade/new/acknowledge");
 		curl_easy_setopt(curl, CURLOPT_POST, 1L);
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
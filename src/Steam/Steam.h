@@ -7,21 +7,14 @@ namespace Steam
 		const size_t jwtBufSz = 600;
 	}
 
-	void RateLimit()
-	{
-		static std::chrono::high_resolution_clock::time_point nextRequestTime;
-		std::this_thread::sleep_until(nextRequestTime);
+	// one request a second, the benchmarks lower it to measure the client rather than the limit
+	std::chrono::microseconds requestInterval = 1s;
 
-		const auto curTime = std::chrono::high_resolution_clock::now();
-		const auto requestInterval = 1s;
-		nextRequestTime = curTime + requestInterval;
-	}
+	CRateLimiterSet rateLimiters("Steam");
 
 	CURLcode curl_easy_perform(CURL* curl)
 	{
-		RateLimit();
-
-		return ::curl_easy_perform(curl);
+		return Curl::Perform(curl, &rateLimiters, requestInterval);
 	}
 
 	inline uint64_t SteamID32To64(uint32_t id32)
@@ -42,7 +42,7 @@ namespace Steam
 
 			strcpy(urlEnd, "accept");
 
-			curl_easy_setopt(curl, CURLOPT_URL, url);
+			Curl::SetUrl(curl, url);
 
 			const char postFieldSession[] = "serverid=1&sessionid=";
 			const char postFieldPartnerId64[] = "&partner=";
@@ -151,7 +151,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/tradeoffer/new/send");
+			Curl::SetUrl(curl, "https://steamcommunity.com/tradeoffer/new/send");
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -214,7 +214,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, url);
+			Curl::SetUrl(curl, url);
 			curl_easy_setopt(curl, CURLOPT_POST, 1L);
 			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields);
 
@@ -314,7 +314,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, url);
+			Curl::SetUrl(curl, url);
 			curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 			const CURLcode respCode = curl_easy_perform(curl);
@@ -351,7 +351,7 @@ namespace Steam
 
 			Curl::CResponse response;
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-			curl_easy_setopt(curl, CURLOPT_URL, "https://steamcommunity.com/my/tradeoffers/privacy");
+			Curl::SetUrl(curl, "https://steamcommunity.com/my/tradeoffers/privacy");
 			curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
 
 			const CURLcode respCode = curl_easy_perform(curl);
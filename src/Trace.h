@@ -0,0 +1,238 @@
+#pragma once
+
+// --trace writes spans in Chrome Trace Event format, load the file in chrome://tracing or ui.perfetto.dev
+// spans are queued without blocking and written by a background thread
+namespace Trace
+{
+	const size_t nameBufSz = 96;
+	const size_t accountBufSz = 64;
+	const size_t spanCount = 4096;
+
+	class CSpanRecord
+	{
+	public:
+		char		name[nameBufSz];
+		const char*	category;	// string literal
+		char		account[accountBufSz];
+		int64_t		startUs;
+		int64_t		durationUs;
+		uint32_t	threadId;
+	};
+
+	CRingBuffer<CSpanRecord, spanCount>	spans;
+
+	std::atomic<bool>					enabled(false);
+	std::atomic<size_t>					droppedCount(0);
+
+	std::chrono::steady_clock::time_point	startTime;
+
+	FILE*								file = nullptr;
+	bool								firstRecord = true;
+
+	std::thread							writerThread;
+	std::atomic<bool>					writerStopping(false);
+	std::mutex							writerMutex;
+	std::condition_variable				writerCondVar;
+
+	inline uint32_t GetThreadId()
+	{
+		static std::atomic<uint32_t> nextThreadId(1);
+		thread_local const uint32_t threadId = nextThreadId++;
+
+		return threadId;
+	}
+
+	inline int64_t GetTimeUs()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// times the scope it lives in, does nothing unless tracing
+	class CTraceSpan
+	{
+		bool		active;
+		int64_t		startUs;
+		const char*	category;
+		char		name[nameBufSz];
+
+	public:
+		CTraceSpan(const char* spanCategory, const char* spanName) : active(enabled)
+		{
+			if (!active)
+				return;
+
+			category = spanCategory;
+			SetName(spanName);
+			startUs = GetTimeUs();
+		}
+
+		// printf style name, e.g. per market spans
+		CTraceSpan(const char* spanCategory, const char* format, const char* arg) : active(enabled)
+		{
+			if (!active)
+				return;
+
+			category = spanCategory;
+			snprintf(name, sizeof(name), format, arg);
+			startUs = GetTimeUs();
+		}
+
+		~CTraceSpan()
+		{
+			if (!active)
+				return;
+
+			const int64_t endUs = GetTimeUs();
+
+			size_t pos;
+			CSpanRecord* record = spans.BeginPush(&pos);
+			if (!record)
+			{
+				++droppedCount;
+				return;
+			}
+
+			strcpy(record->name, name);
+			record->category = category;
+			record->startUs = startUs;
+			record->durationUs = endUs - startUs;
+			record->threadId = GetThreadId();
+
+			if (g_pszLogAccountName)
+			{
+				const size_t len = std::min(strlen(g_pszLogAccountName), sizeof(record->account) - 1);
+				memcpy(record->account, g_pszLogAccountName, len);
+				record->account[len] = '\0';
+			}
+			else
+				record->account[0] = '\0';
+
+			spans.EndPush(pos);
+		}
+
+		CTraceSpan(const CTraceSpan&) = delete;
+		CTraceSpan(const CTraceSpan&&) = delete;
+
+		// for spans whose name is only known at the end, like the endpoint of a request
+		void SetName(const char* spanName)
+		{
+			if (!active)
+				return;
+
+			const size_t len = std::min(strlen(spanName), sizeof(name) - 1);
+			memcpy(name, spanName, len);
+			name[len] = '\0';
+		}
+
+		bool IsActive() const
+		{
+			return active;
+		}
+	};
+
+	void WriteRecord(const CSpanRecord* record)
+	{
+		fputs(firstRecord ? "\n" : ",\n", file);
+		firstRecord = false;
+
+		fputs("{\"name\":", file);
+		WriteJsonString(file, record->name);
+		fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%u",
+			record->category, (long long)record->startUs, (long long)record->durationUs, record->threadId);
+
+		if (record->account[0])
+		{
+			fputs(",\"args\":{\"account\":", file);
+			WriteJsonString(file, record->account);
+			fputc('}', file);
+		}
+
+		fputc('}', file);
+	}
+
+	void WriterMain()
+	{
+		while (true)
+		{
+			bool wrote = false;
+
+			CSpanRecord* record;
+			while ((record = spans.Peek()))
+			{
+				WriteRecord(record);
+				spans.Pop();
+				wrote = true;
+			}
+
+			if (wrote)
+				fflush(file);
+
+			const size_t dropped = droppedCount.exchange(0);
+			if (dropped)
+				Log(LogChannel::GENERAL, "%zu trace spans dropped, the trace buffer was full\n", dropped);
+
+			if (writerStopping && spans.IsEmpty())
+				break;
+
+			std::unique_lock<std::mutex> lock(writerMutex);
+			if (!writerStopping)
+				writerCondVar.wait_for(lock, 200ms);
+		}
+	}
+
+	bool Start(const char* path)
+	{
+		Log(LogChannel::GENERAL, "Opening trace file %s...", path);
+
+		file = fopen(path, "wb");
+		if (!file)
+		{
+			putsnn("fail\n");
+			return false;
+		}
+
+		// the array format lets viewers load a trace that was cut short by a crash
+		fputc('[', file);
+		firstRecord = true;
+
+		startTime = std::chrono::steady_clock::now();
+
+		writerStopping = false;
+		writerThread = std::thread(WriterMain);
+		enabled = true;
+
+		putsnn("ok\n");
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!enabled)
+			return;
+
+		enabled = false;
+
+		{
+			std::lock_guard<std::mutex> lock(writerMutex);
+			writerStopping = true;
+		}
+		writerCondVar.notify_one();
+		writerThread.join();
+
+		fputs("\n]\n", file);
+		fclose(file);
+		file = nullptr;
+	}
+
+	// stops tracing when leaving main
+	class CTraceContext
+	{
+	public:
+		CTraceContext() {
+
+		}
+		~CTraceContext() {
+			Stop();
+		}
+	};
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif // __linux__
+
+// reports files that were added to or removed from a directory
+class CDirectoryWatcher
+{
+public:
+	enum class EventType
+	{
+		ADDED,		// created, finished writing or moved in
+		REMOVED		// deleted or moved out
+	};
+
+	class CEvent
+	{
+	public:
+		EventType				type;
+		std::filesystem::path	path;
+
+		CEvent(EventType eventType, const std::filesystem::path& eventPath) : type(eventType), path(eventPath)
+		{
+
+		}
+	};
+
+private:
+	std::filesystem::path dir;
+
+#ifdef __linux__
+	int inotifyFd = -1;
+	int watchFd = -1;
+#else
+	// no inotify, compare directory snapshots instead
+	std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> snapshot;
+
+	void TakeSnapshot(decltype(snapshot)* out)
+	{
+		out->clear();
+
+		std::error_code err;
+		for (const auto& entry : std::filesystem::directory_iterator(dir, err))
+			out->emplace_back(entry.path(), entry.last_write_time(err));
+
+		std::sort(out->begin(), out->end());
+	}
+#endif // __linux__
+
+public:
+	CDirectoryWatcher()
+	{
+
+	}
+
+	~CDirectoryWatcher()
+	{
+#ifdef __linux__
+		if (inotifyFd != -1)
+			close(inotifyFd);
+#endif // __linux__
+	}
+
+	CDirectoryWatcher(const CDirectoryWatcher&) = delete;
+	CDirectoryWatcher(const CDirectoryWatcher&&) = delete;
+
+	bool Init(const char* path)
+	{
+		dir = path;
+
+		std::error_code err;
+		if (!std::filesystem::exists(dir, err) && !std::filesystem::create_directory(dir, err))
+		{
+			Log(LogChannel::GENERAL, "Watching %s failed: directory creation failed\n", path);
+			return false;
+		}
+
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd == -1)
+		{
+			Log(LogChannel::GENERAL, "Watching %s failed: inotify init failed\n", path);
+			return false;
+		}
+
+		// IN_CLOSE_WRITE instead of IN_CREATE so we don't read half copied files
+		watchFd = inotify_add_watch(inotifyFd, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM);
+		if (watchFd == -1)
+		{
+			close(inotifyFd);
+			inotifyFd = -1;
+			Log(LogChannel::GENERAL, "Watching %s failed: adding inotify watch failed\n", path);
+			return false;
+		}
+#else
+		TakeSnapshot(&snapshot);
+#endif // __linux__
+
+		return true;
+	}
+
+	bool IsActive() const
+	{
+#ifdef __linux__
+		return (inotifyFd != -1);
+#else
+		return !dir.empty();
+#endif // __linux__
+	}
+
+	// waits up to timeout for changes and appends them to out
+	void Wait(std::chrono::milliseconds timeout, std::vector<CEvent>* out)
+	{
+#ifdef __linux__
+		pollfd pfd;
+		pfd.fd = inotifyFd;
+		pfd.events = POLLIN;
+
+		if (poll(&pfd, 1, (int)timeout.count()) <= 0)
+			return;
+
+		alignas(inotify_event) char buf[4096];
+
+		while (true)
+		{
+			const ssize_t readSz = read(inotifyFd, buf, sizeof(buf));
+			if (readSz <= 0)
+				break;
+
+			for (const char* iter = buf; iter < buf + readSz; )
+			{
+				const inotify_event* event = (const inotify_event*)iter;
+				iter += sizeof(inotify_event) + event->len;
+
+				if (!event->len)
+					continue;
+
+				const EventType type = ((event->mask & (IN_DELETE | IN_MOVED_FROM)) ? EventType::REMOVED : EventType::ADDED);
+
+				out->emplace_back(type, dir / event->name);
+			}
+		}
+#else
+		std::this_thread::sleep_for(timeout);
+
+		decltype(snapshot) curSnapshot;
+		TakeSnapshot(&curSnapshot);
+
+		// both are sorted, walk them together
+		auto iterOld = snapshot.cbegin();
+		auto iterNew = curSnapshot.cbegin();
+
+		while (iterOld != snapshot.cend() || iterNew != curSnapshot.cend())
+		{
+			if (iterNew == curSnapshot.cend() || (iterOld != snapshot.cend() && iterOld->first < iterNew->first))
+			{
+				out->emplace_back(EventType::REMOVED, iterOld->first);
+				++iterOld;
+			}
+			else if (iterOld == snapshot.cend() || iterNew->first < iterOld->first)
+			{
+				out->emplace_back(EventType::ADDED, iterNew->first);
+				++iterNew;
+			}
+			else
+			{
+				if (iterOld->second != iterNew->second)
+					out->emplace_back(EventType::ADDED, iterNew->first);
+
+				++iterOld;
+				++iterNew;
+			}
+		}
+
+		snapshot = std::move(curSnapshot);
+#endif // __linux__
+	}
+};